@@ -682,3 +682,82 @@ AC_DEFUN([AC_C_LONG_LONG],
 ])
 
 
+dnl --------------------------------------------------------------------------
+dnl @synopsis AC_HAVE_MMAP
+dnl
+dnl See whether files can be mapped into memory with the POSIX mmap 
+dnl function, and set HAVE_MMAP to 1 or 0 accordingly.
+dnl
+AC_DEFUN([AC_HAVE_MMAP],
+ [AC_CACHE_CHECK(
+    [for mmap],
+    [ac_cv_have_mmap],
+    [AC_LANG_PUSH(C++)
+     AC_LINK_IFELSE(
+       [AC_LANG_PROGRAM(
+         [#include <sys/types.h>
+          #include <sys/mman.h>
+          #include <sys/stat.h>
+          #include <fcntl.h>
+          #include <unistd.h>
+         ],
+         [int fd = open("x", O_RDONLY);
+          void* p = mmap(0, 1, PROT_READ, MAP_SHARED, fd, 0);
+          munmap(p, 1);  close(fd);])],
+       ac_cv_have_mmap=yes,
+       ac_cv_have_mmap=no)
+     AC_LANG_POP(C++)])
+  if test "$ac_cv_have_mmap" = yes; then
+    HAVE_MMAP=1
+  else
+    HAVE_MMAP=0
+  fi
+])
+
+
+dnl --------------------------------------------------------------------------
+dnl @synopsis AC_USE_PTHREADS
+dnl
+dnl See whether POSIX threads are available, and what libraries are 
+dnl needed to use them.
+dnl
+AC_DEFUN([AC_USE_PTHREADS],
+ [AC_ARG_WITH(
+    threads,
+    AC_HELP_STRING([--with-threads], [support multithreaded searches]),
+    ac_cv_use_pthreads=$withval
+  )
+  if test "$ac_cv_use_pthreads" != no; then
+    AC_CACHE_CHECK(
+      [what libraries are needed for POSIX threads],
+      [ac_cv_pthread_libs],
+      [AC_LANG_PUSH(C++)
+       ac_check_cxx_lib_save_LIBS="$LIBS"
+       ac_cv_pthread_libs=no
+       for library in "" -lpthread -pthread; do
+	 if test "$ac_cv_pthread_libs" = no; then
+	   LIBS="$ac_check_cxx_lib_save_LIBS $library"
+	   AC_LINK_IFELSE(
+             [AC_LANG_PROGRAM(
+               [#include <pthread.h>
+                extern "C" void* start( void* p ) { return p; }
+               ], 
+               [pthread_t t;  pthread_create(&t, NULL, &start, NULL);
+                pthread_join(t, NULL);])],
+             ac_cv_pthread_libs="$library")
+	 fi
+       done
+       LIBS="$ac_check_cxx_lib_save_LIBS"
+       AC_LANG_POP(C++)])
+    if test "$ac_cv_pthread_libs" = no; then
+      ac_cv_use_pthreads=no
+    fi
+  fi
+  if test "$ac_cv_use_pthreads" != no; then
+    USE_THREADS=1
+    THREAD_LIBS="$ac_cv_pthread_libs"
+  else
+    USE_THREADS=0
+    THREAD_LIBS=
+  fi
+])
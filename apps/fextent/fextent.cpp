@@ -24,6 +24,7 @@
 #include <ringing/pointers.h>
 #include <ringing/streamutils.h>
 #include <ringing/mathutils.h>
+#include <ringing/thread.h>
 
 #include <vector>
 #include <cmath>
@@ -97,6 +98,42 @@ inline void clear_status()
   status_out("");
 }
 
+// The random number generator for one chain.  Each chain has its own
+// generator, rather than sharing rand(), so that chains can be run in 
+// parallel and still give the same results from a given seed.  This is
+// the SplitMix64 generator.
+class chain_random
+{
+public:
+  explicit chain_random( RINGING_ULLONG seed = 0 ) : x(seed) {}
+
+  // Uniformly distributed, 0 <= random_int(max) < max
+  unsigned random_int( unsigned max ) 
+    { return unsigned( uniform_deviate() * max ); }
+
+  // Returns true with probability ptrue
+  bool random_bool( double ptrue ) 
+    { return uniform_deviate() < ptrue; }
+
+private:
+  static RINGING_ULLONG k( unsigned long hi, unsigned long lo ) 
+    { return (RINGING_ULLONG) hi << 32 | lo; }
+
+  // Uniformly distributed, 0 <= uniform_deviate() < 1
+  double uniform_deviate() 
+    { return ( next() >> 11 ) / 9007199254740992.0; }
+
+  RINGING_ULLONG next() 
+  {
+    RINGING_ULLONG z = ( x += k( 0x9e3779b9u, 0x7f4a7c15u ) );
+    z = ( z ^ ( z >> 30 ) ) * k( 0xbf58476du, 0x1ce4e5b9u );
+    z = ( z ^ ( z >> 27 ) ) * k( 0x94d049bbu, 0x133111ebu );
+    return z ^ ( z >> 31 );
+  }
+
+  RINGING_ULLONG x;
+};
+
 struct weighting 
 {
   weighting();
@@ -132,6 +169,8 @@ struct arguments
   init_val<bool,false>    principle;
 
   init_val<int,1>         loop;
+  init_val<int,1>         threads;
+  init_val<bool,false>    tempering;
 
   init_val<bool,false>    print_leads;
   init_val<int, 0>        min_leads;
@@ -139,6 +178,8 @@ struct arguments
   init_val<bool,false>    quiet;
   init_val<bool,false>    status;
 
+  string                  table_cache;
+
   string                  meth_str;
   method                  meth;
 
@@ -353,6 +394,18 @@ void arguments::bind( arg_parser& p )
 	   "Repeat some number of times (or indefinitely)", "NUM",
 	   loop, -1 ) );
 
+  p.add( new integer_opt
+	 ( '\0', "threads",
+	   "Run NUM chains at once, each in its own thread "
+	   "(0 = one per processor)", "NUM",
+	   threads ) );
+
+  p.add( new boolean_opt
+	 ( '\0', "tempering",
+	   "Exchange leads between the chains, which are run at different "
+	   "temperatures (parallel tempering)",
+	   tempering ) );
+
   p.add( new strings_opt
 	 ( 'P', "part-end",
 	   "Specify a part-end",  "ROW",
@@ -402,6 +455,12 @@ void arguments::bind( arg_parser& p )
 	 ( 'W', "weighting",
 	   "Specify a weighting", "OPTION=WEIGHT",
 	   wprof ) );
+
+  p.add( new string_opt
+	 ( '\0', "table-cache",
+	   "Read the multiplication table from FILE, or save it there "
+	   "if it is not in FILE", "FILE",
+	   table_cache ) );
 }
 
 bool arguments::validate( arg_parser& ap )
@@ -430,6 +489,18 @@ bool arguments::validate( arg_parser& ap )
     return false;
   }
 
+  if ( threads < 0 ) {
+    ap.error( "The number of threads must not be negative" );
+    return false;
+  }
+  if ( threads == 0 ) 
+    threads = hardware_concurrency();
+
+  if ( tempering && threads < 2 ) {
+    ap.error( "Parallel tempering needs at least two threads" );
+    return false;
+  }
+
   if ( principle & whole_courses ) {
     ap.error( "Searching for principles in whole courses is not supported" );
     return false;
@@ -463,11 +534,14 @@ public:
 
   state( const method& m, int flags, const group& pgrp,
 	 vector<row> const& required_rows, vector<change> const& calls,
-	 weighting const& wprof );
+	 weighting const& wprof, string const& table_cache );
 
   void set_beta(double b) { beta = b; }
+  void seed( RINGING_ULLONG s ) { rnd = chain_random(s); }
   bool perturb(); // returns true if perturbation was kept
 
+  double score() const { return sc; }
+
   void prune_unlinked();
 
   int length() const {
@@ -554,7 +628,8 @@ public:
   void clear();
 
 private:
-  void init_mt( method const& m, group const& pgrp, weighting const& wprof );
+  void init_mt( method const& m, group const& pgrp, weighting const& wprof,
+                string const& table_cache );
   void init_fchs( method const& m );
   void init_flhs( method const& m );
   void init_req( method const& m, vector<row> const& required_rows );
@@ -566,7 +641,7 @@ private:
   friend class const_iterator;
   
   inline bool should_keep( double delta ) {
-    return delta > 0 || random_bool( exp(delta * beta) );
+    return delta > 0 || rnd.random_bool( exp(delta * beta) );
   }
 
   typedef multtab::row_t      row_t;
@@ -586,11 +661,14 @@ private:
   const double link_weight;
 
   double beta;
+  chain_random rnd;
   double sc;
   int len, links;
   int flags;
   int nw, nh;
-  scoped_pointer<multtab> mt;
+  // Copies of a state share the table, which is not changed once
+  // the state has been constructed
+  shared_pointer<multtab> mt;
   vector<double> weight;
   vector<fch_t> fchs;
   vector<row_t> req_rows;
@@ -649,7 +727,7 @@ void state::dump( ostream& os ) const
 }
 
 void state::init_mt( method const& m, group const& pgrp, 
-		     weighting const& wprof )
+		     weighting const& wprof, string const& table_cache )
 {
   status_out( "Generating multiplication table ..." );
 
@@ -659,10 +737,12 @@ void state::init_mt( method const& m, group const& pgrp,
 
   if ( flags & in_course_only )
     mt.reset( new multtab( incourse_extent_iterator(nw, nh, bells),
-			   incourse_extent_iterator(), pgrp, postgroup ) );
+			   incourse_extent_iterator(), pgrp, postgroup, 
+			   table_cache ) );
   else
     mt.reset( new multtab( extent_iterator(nw, nh, bells),
-			   extent_iterator(), pgrp, postgroup ) );
+			   extent_iterator(), pgrp, postgroup, 
+			   table_cache ) );
 
   assert( mt->size() * pgrp.size() 
 	  == factorial(nw) / ( (flags & in_course_only) ? 2 : 1 ) );
@@ -922,7 +1002,7 @@ void state::init_qsets( method const& m, vector<change> const& calls )
 
 state::state( const method& m, int flags, const group& pgrp, 
 	      const vector<row>& required_rows, const vector<change>& calls,
-	      const weighting& wprof )
+	      const weighting& wprof, const string& table_cache )
   : bells(m.bells()), courselen(m.leads()), 
     link_weight( wprof.linked_course ),
     beta(0), flags(flags)
@@ -934,7 +1014,7 @@ state::state( const method& m, int flags, const group& pgrp,
   else
     nw = m.bells() - nh;
   
-  init_mt( m, pgrp, wprof );
+  init_mt( m, pgrp, wprof, table_cache );
  
   if ( flags & whole_courses )
     init_fchs( m );
@@ -952,6 +1032,10 @@ state::state( const method& m, int flags, const group& pgrp,
 	init_lhs( m, calls );
     }
 
+  // Save the table with the columns added above
+  if ( !mt->cached() )
+    mt->save( table_cache );
+
   clear();
 }
 
@@ -1487,7 +1571,7 @@ bool state::perturb()
 {
   perturbation p( *this );
 
-  int ri = random_int( leads.size() );
+  int ri = rnd.random_int( leads.size() );
   bool valid(false);
 
   if ( leads[ri] == present )
@@ -1509,6 +1593,70 @@ bool state::perturb()
 }
 
 
+struct chain_stats 
+{
+  chain_stats() : steps(0u), kept(0u), swaps(0u), highest(0) {}
+
+  RINGING_ULLONG steps, kept;
+  unsigned swaps;
+  int highest;
+};
+
+// Runs one chain for a number of steps, multiplying beta by beta_mult
+// after each step.
+class chain_task : public thread_task
+{
+public:
+  chain_task( state& s, chain_stats& stats ) 
+    : s(s), stats(stats), beta(0), beta_mult(1), steps(0), status(false) 
+  {}
+
+  void schedule( double b, double mult, int n, bool show_status ) 
+    { beta = b; beta_mult = mult; steps = n; status = show_status; }
+
+private:
+  virtual void run() {
+    for ( int n = 0; n < steps; ++n, beta *= beta_mult ) {
+      s.set_beta(beta);
+      ++stats.steps;
+      if ( s.perturb() ) 
+	++stats.kept;
+
+      if ( status && n % 1000 == 0 )
+	status_out( make_string() << "Currently " 
+		    << floor(double(n)/steps * 1000)/10. << "% done" );
+    }
+  }
+
+  state& s;
+  chain_stats& stats;
+  double beta, beta_mult;
+  int steps;
+  bool status;
+};
+
+// Offer to swap the chains at adjacent temperatures, starting with the
+// hottest or second hottest.  ORDER[i] is the chain at temperature 
+// BETAS[i].
+void exchange_chains( vector< shared_pointer<state> > const& chains,
+		      vector<double> const& betas, vector<size_t>& order,
+		      vector<chain_stats>& stats, chain_random& rnd, 
+		      size_t first )
+{
+  for ( size_t i = first; i+1 < order.size(); i += 2 ) 
+    {
+      state const& a = *chains[ order[i] ];
+      state const& b = *chains[ order[i+1] ];
+      double const d 
+	= ( betas[i] - betas[i+1] ) * ( b.score() - a.score() );
+
+      if ( d >= 0 || rnd.random_bool( exp(d) ) ) {
+	++stats[ order[i] ].swaps;  ++stats[ order[i+1] ].swaps;
+	swap( order[i], order[i+1] );
+      }
+    }
+}
+
 int main( int argc, char* argv[] )
 {
   try {
@@ -1526,7 +1674,7 @@ int main( int argc, char* argv[] )
       if ( args.principle )       stflags |= state::principle;
       
       s.reset( new state( args.meth, stflags, args.pends, args.required, 
-			  args.calls, args.wprof  ) );
+			  args.calls, args.wprof, args.table_cache ) );
       clear_status();
     }
     catch ( exception const& ex ) {
@@ -1538,74 +1686,133 @@ int main( int argc, char* argv[] )
     int mx = 0;
     
     if ( args.seed == -1 )
-      srand( args.seed = time(NULL) );
-    else if ( args.seed )
-      srand( args.seed );
+      args.seed = time(NULL);
     
     if ( args.seed && !args.quiet )
       cout << "Started with seed " << int(args.seed) << endl;
     
     if ( !args.quiet )
       cout << "Using part-end group of order " << args.pends.size() << endl;
-  
+
+    // Each chain is a copy of the state, and so shares its table, and 
+    // has its generator seeded from the seed and the chain's number.
+    vector< shared_pointer<state> > chains;
+    vector<chain_stats> stats( args.threads );
+    vector< shared_pointer<chain_task> > tasks;
+    vector< thread_task* > task_ptrs;
+    for ( int c = 0; c < args.threads; ++c ) {
+      chains.push_back( shared_pointer<state>( new state(*s) ) );
+      chains.back()->seed( (RINGING_ULLONG) unsigned(args.seed) << 32 | c );
+      tasks.push_back( shared_pointer<chain_task>
+		       ( new chain_task( *chains.back(), stats[c] ) ) );
+      task_ptrs.push_back( tasks.back().get() );
+    }
+    s.reset();
+
+    chain_random exchange_rnd
+      ( (RINGING_ULLONG) unsigned(args.seed) << 32 | 0xFFFFFFFFu );
+
+    const double beta_init  = 3;
+    const double beta_final = 25;
+
+    // With parallel tempering, each chain stays at one temperature 
+    // for this many steps before offering to exchange leads with its
+    // neighbours.  Otherwise, each chain is annealed independently.
+    const int exchange_steps = 1000;
+
     for ( int i=0; args.loop == -1 || i < args.loop; ++i ) {
       
-      const double beta_init  = 3;
-      const double beta_final = 25;
+      if ( !args.tempering ) {
+	const double beta_mult
+	  = pow( beta_final / beta_init, 1/double(args.num_steps) );
+
+	for ( int c = 0; c < args.threads; ++c ) 
+	  tasks[c]->schedule( beta_init, beta_mult, args.num_steps, 
+			      args.status && c == 0 );
+	run_threads( task_ptrs );
+      }
+      else {
+	// The temperatures are spaced geometrically, coldest first
+	vector<double> betas( args.threads );
+	vector<size_t> order( args.threads );
+	for ( int c = 0; c < args.threads; ++c ) {
+	  betas[c] = beta_final 
+	    * pow( beta_init / beta_final, c / double(args.threads - 1) );
+	  order[c] = c;
+	}
 
-      
-      const double beta_mult
-	= pow( beta_final / beta_init, 1/double(args.num_steps) );
-      
-      int n = 0;
-      for ( double beta = beta_init ; beta < beta_final; beta *= beta_mult ) {
-	s->set_beta(beta);
-	s->perturb();
+	for ( int n = 0; n < args.num_steps; n += exchange_steps ) {
+	  for ( int c = 0; c < args.threads; ++c ) 
+	    tasks[ order[c] ]->schedule
+	      ( betas[c], 1, min( exchange_steps, args.num_steps - n ), 
+		false );
+	  run_threads( task_ptrs );
+
+	  exchange_chains( chains, betas, order, stats, exchange_rnd, 
+			   n / exchange_steps % 2 );
 
-	if ( args.status ) {
-	  if ( n++% 1000 == 0 )
+	  if ( args.status )
 	    status_out( make_string() << "Currently " 
 			<< floor(double(n)/args.num_steps * 1000)/10. 
 			<< "% done" );
 	}
       }
 
-      if ( args.linkage && !s->fully_linked() )
-	s->prune_unlinked();
-
       clear_status();
 
+      for ( int c = 0; c < args.threads; ++c ) {
+	state& ch = *chains[c];
+
+	if ( args.linkage && !ch.fully_linked() )
+	  ch.prune_unlinked();
+
 #if ENABLE_CHECKS
-      if (!s->check()) { 
-	cerr << "ERROR!!!" << endl;
-	s->dump( cerr );
-	exit(1);
-      }
+	if (!ch.check()) { 
+	  cerr << "ERROR!!!" << endl;
+	  ch.dump( cerr );
+	  exit(1);
+	}
 #endif
 
-      if ( s->length() > mx && ( !args.linkage || s->fully_linked() ) ) 
-	mx = s->length();
+	if ( !args.linkage || ch.fully_linked() ) {
+	  mx = max( mx, ch.length() );
+	  stats[c].highest = max( stats[c].highest, ch.length() );
+	}
       
-      if ( !args.quiet ) {
-	cout << s->length() << " leads " 
-	     << "(" << s->length() * args.meth.size() << ")";
-	if ( args.linkage && !s->fully_linked() )
-	  cout << " not fully linked (" << setw(2) << s->percent_linked() << "%)";
-	if ( args.loop != 1 )
-	  cout << " [highest = " << mx << " leads "
-	       << "(" << mx * args.meth.size() << ")]";
-	cout << endl;
-      }
+	if ( !args.quiet ) {
+	  if ( args.threads > 1 )
+	    cout << "Chain " << c << ": ";
+	  cout << ch.length() << " leads " 
+	       << "(" << ch.length() * args.meth.size() << ")";
+	  if ( args.linkage && !ch.fully_linked() )
+	    cout << " not fully linked (" << setw(2) << ch.percent_linked() 
+		 << "%)";
+	  if ( args.loop != 1 || args.threads > 1 )
+	    cout << " [highest = " << mx << " leads "
+		 << "(" << mx * args.meth.size() << ")]";
+	  cout << endl;
+	}
 
-      if ( args.print_leads && s->length() >= args.min_leads 
-	   && ( !args.linkage || s->fully_linked() ) ) {
-	s->dump( cout );
-	cout << "\n\n\n" << endl;
-      }
+	if ( args.print_leads && ch.length() >= args.min_leads 
+	     && ( !args.linkage || ch.fully_linked() ) ) {
+	  ch.dump( cout );
+	  cout << "\n\n\n" << endl;
+	}
 
-      s->clear();
+	ch.clear();
+      }
     }
 
+    if ( !args.quiet && args.threads > 1 )
+      for ( int c = 0; c < args.threads; ++c ) {
+	cout << "Chain " << c << ": highest " << stats[c].highest 
+	     << " leads; kept " << stats[c].kept << " of " << stats[c].steps 
+	     << " perturbations";
+	if ( args.tempering )
+	  cout << "; " << stats[c].swaps << " exchanges";
+	cout << endl;
+      }
+
     if ( args.quiet )
       cout << mx << endl;
 
@@ -64,6 +64,14 @@ void expression::execute( proof_context &ctx, int dir ) const
   impl->execute(ctx, dir); 
 }
 
+bool expression::compile( proof_context& ctx, vector<change>& ch ) const
+{
+  shared_pointer< vector<change> > block( ctx.compile( impl.get() ) );
+  if ( !block ) return false;
+  ch.insert( ch.end(), block->begin(), block->end() );
+  return true;
+}
+
 bool expression::evaluate( proof_context& ctx ) const 
 { 
   ctx.increment_node_count();
@@ -32,9 +32,20 @@
 #else
 #include <iosfwd>
 #endif
+#if RINGING_OLD_INCLUDES
+#include <vector.h>
+#else
+#include <vector>
+#endif
 #include <ringing/pointers.h>
 
+// Forward declare ringing::change
+RINGING_START_NAMESPACE
+class change;
+RINGING_END_NAMESPACE
+
 RINGING_USING_NAMESPACE
+RINGING_USING_STD
 
 class proof_context;
 class execution_context;
@@ -77,6 +88,14 @@ public:
     virtual void execute( proof_context &ctx, int dir ) const = 0;
     virtual bool evaluate( proof_context &ctx ) const; // throws
     virtual bool isnop() const { return false; }
+
+    // Whether executing the node might define a symbol
+    virtual bool defines_symbols( proof_context & ) const { return true; }
+
+    // If executing the node forwards always applies the same changes
+    // and does nothing else, append them to ch and return true.  
+    virtual bool compile( proof_context &, vector<change> & ) const
+      { return false; }
     virtual type_t type() const { return no_type; }
   };
 
@@ -92,6 +111,8 @@ public:
 
   bool isnull() const { return !impl; }
   bool isnop() const { return !impl || impl->isnop(); }
+  bool defines_symbols( proof_context &ctx ) const 
+    { return impl && impl->defines_symbols(ctx); }
   type_t type() const { return impl ? impl->type() : no_type; }
 
 
@@ -100,6 +121,9 @@ public:
   // execute an expression, possibly adding to the current proof
   void execute( proof_context &ctx, int dir ) const;
 
+  // Append the changes the expression executes to ch, if they are fixed
+  bool compile( proof_context &ctx, vector<change> &ch ) const;
+
   // Evaluate a const expression in boolean context.
   // If evaluation requires execution of an expression, a silent clone
   // of the proof_context is made and discarded at the end of the evaluation.
@@ -25,6 +25,7 @@
 #endif
 
 #include <iterator>
+#include <algorithm>
 
 #include "expression.h"
 #include "proof_context.h"
@@ -48,11 +49,27 @@ void list_node::debug_print( ostream &os ) const
 
 void list_node::execute( proof_context &ctx, int dir ) const
 {
+  shared_pointer< vector<change> > block( ctx.compile(this) );
+  if ( block ) {
+    ctx.execute_block( *block, dir );
+    return;
+  }
+
   if (dir > 0) car.execute( ctx, dir );
   cdr.execute( ctx, dir );
   if (dir <= 0) car.execute( ctx, dir );
 }
 
+bool list_node::compile( proof_context &ctx, vector<change> &ch ) const
+{
+  return car.compile( ctx, ch ) && cdr.compile( ctx, ch );
+}
+
+bool list_node::defines_symbols( proof_context &ctx ) const
+{
+  return car.defines_symbols(ctx) || cdr.defines_symbols(ctx);
+}
+
 bool list_node::evaluate( proof_context &ctx ) const
 {
   car.execute( ctx, +1 );
@@ -78,6 +95,16 @@ bool nop_node::isnop() const
   return true;
 }
 
+bool nop_node::compile( proof_context &, vector<change> & ) const
+{
+  return true;
+}
+
+bool nop_node::defines_symbols( proof_context & ) const
+{
+  return false;
+}
+
 void repeated_node::debug_print( ostream &os ) const
 {
   if (count != -1) os << count << " ";
@@ -113,11 +140,24 @@ void reverse_node::execute( proof_context &ctx, int dir ) const
   child.execute( ctx, -dir );
 }
 
+bool reverse_node::compile( proof_context &ctx, vector<change> &ch ) const
+{
+  size_t const start = ch.size();
+  if ( !child.compile( ctx, ch ) ) return false;
+  reverse( ch.begin() + start, ch.end() );
+  return true;
+}
+
 void string_node::execute( proof_context &ctx, int dir ) const
 {
   ctx.output_string(str);
 }
 
+bool string_node::defines_symbols( proof_context & ) const
+{
+  return false;
+}
+
 void string_node::debug_print( ostream &os ) const
 {
   os << "\"" << str << "\"";
@@ -156,6 +196,12 @@ void pn_node::execute( proof_context &ctx, int dir ) const
     for_each( changes.rbegin(), changes.rend(), ctx.permute_and_prove() );
 }
 
+bool pn_node::compile( proof_context &ctx, vector<change> &ch ) const
+{
+  ch.insert( ch.end(), changes.begin(), changes.end() );
+  return true;
+}
+
 transp_node::transp_node( int bells, const string &r )
   : transp(bells)
 {
@@ -185,7 +231,22 @@ void symbol_node::debug_print( ostream &os ) const
 
 void symbol_node::execute( proof_context &ctx, int dir ) const
 {
-  ctx.execute_symbol(sym, dir);
+  shared_pointer< vector<change> > block( ctx.compile(this) );
+  if ( block ) 
+    ctx.execute_block( *block, dir );
+  else
+    ctx.execute_symbol(sym, dir);
+}
+
+bool symbol_node::compile( proof_context &ctx, vector<change> &ch ) const
+{
+  expression e( ctx.find_symbol(sym) );
+  return !e.isnull() && e.compile( ctx, ch );
+}
+
+bool symbol_node::defines_symbols( proof_context &ctx ) const
+{
+  return ctx.symbol_defines_symbols(sym);
 }
 
 void assign_node::debug_print( ostream &os ) const
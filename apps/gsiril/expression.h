@@ -58,6 +58,8 @@ protected:
   virtual void execute( proof_context &ctx, int dir ) const;
   virtual bool evaluate( proof_context &ctx ) const;
   virtual expression::type_t type() const;
+  virtual bool compile( proof_context &ctx, vector<change> &ch ) const;
+  virtual bool defines_symbols( proof_context &ctx ) const;
 
 private:  
   expression car, cdr;
@@ -69,6 +71,8 @@ protected:
   virtual void debug_print( ostream &os ) const;
   virtual void execute( proof_context &, int dir ) const;
   virtual bool isnop() const;
+  virtual bool compile( proof_context &, vector<change> & ) const;
+  virtual bool defines_symbols( proof_context & ) const;
 };
 
 class repeated_node : public expression::node
@@ -96,6 +100,7 @@ public:
 protected:
   virtual void debug_print( ostream &os ) const;
   virtual void execute( proof_context &ctx, int dir ) const;
+  virtual bool compile( proof_context &ctx, vector<change> &ch ) const;
 
 private:  
   expression child;
@@ -110,6 +115,7 @@ public:
 protected:
   virtual void debug_print( ostream &os ) const;
   virtual void execute( proof_context &ctx, int dir ) const;
+  virtual bool defines_symbols( proof_context & ) const;
 
 private:
   string str;
@@ -126,6 +132,7 @@ public:
 protected:
   virtual void debug_print( ostream &os ) const;
   virtual void execute( proof_context &ctx, int dir ) const;
+  virtual bool compile( proof_context &ctx, vector<change> &ch ) const;
 
 private:
   vector< change > changes;
@@ -153,6 +160,8 @@ public:
 protected:
   virtual void debug_print( ostream &os ) const;
   virtual void execute( proof_context &ctx, int dir ) const;
+  virtual bool compile( proof_context &ctx, vector<change> &ch ) const;
+  virtual bool defines_symbols( proof_context &ctx ) const;
 
 private:
   string sym;
@@ -47,12 +47,23 @@
 RINGING_USING_NAMESPACE
 
 proof_context::proof_context( const execution_context &ectx ) 
-  : ectx(ectx), p( new prover(ectx.get_args().num_extents) ), 
+  : ectx(ectx), 
+    p( new prover( ectx.get_args().num_extents, 
+                   prover::automatic_storage ) ), 
     output( &ectx.output() ),
     silent( ectx.get_args().everyrow_only || ectx.get_args().filter
             || ectx.get_args().quiet >= 2 ), 
-    underline( false )
+    underline( false ),
+    rounds_row( ectx.rounds() ),
+    extents( ectx.extents() ),
+    everyrow_hook( NULL ), rounds_hook( NULL ), conflict_hook( NULL ),
+    hooks_define_symbols( true ), compiled_rows( 0u )
 {
+  // Compiled blocks would skip the lead heads printed for inner symbols 
+  // and change the node count
+  if ( !ectx.get_args().show_lead_heads && !ectx.get_args().node_limit )
+    blocks.reset( new block_cache );
+
 # if RINGING_USE_TERMCAP
   static bool terminfo_initialized = false;
   if ( !terminfo_initialized ) {
@@ -66,6 +77,7 @@ proof_context::proof_context( const execution_context &ectx )
   if ( ectx.rounds().bells() > ectx.bells() )
     throw runtime_error( "Rounds is on too many bells" ); 
   r = row(ectx.bells()) * ectx.rounds();
+  lookup_hooks();
 }
 
 proof_context::~proof_context()
@@ -102,11 +114,18 @@ void proof_context::output_string( const string& str )
 
 void proof_context::execute_everyrow()
 {
+  // The usual case when just proving: there is nothing to execute, 
+  // though it still counts towards the node limit.
+  if ( !everyrow_hook.isnull() && everyrow_hook.isnop() ) {
+    increment_node_count();
+    return;
+  }
+
   // Temporarily disable silent flag if running with -E
   bool s = silent;
   if ( ectx.get_args().everyrow_only && !ectx.get_args().filter ) 
     silent = false;
-  execute_symbol("everyrow");
+  execute_hook("everyrow", everyrow_hook);
   silent = s;
 }
 
@@ -114,8 +133,8 @@ bool proof_context::permute_and_prove_t::operator()( const change &c )
 {
   bool rv = p.add_row( r *= c ); 
   pctx.execute_everyrow();
-  if ( pctx.isrounds() ) pctx.execute_symbol("rounds");
-  if ( !rv ) pctx.execute_symbol("conflict");
+  if ( pctx.isrounds() ) pctx.execute_hook("rounds", pctx.rounds_hook);
+  if ( !rv ) pctx.execute_hook("conflict", pctx.conflict_hook);
   return rv;
 }
 
@@ -123,8 +142,8 @@ bool proof_context::permute_and_prove_t::operator()( const row &c )
 {
   bool rv = p.add_row( r *= c ); 
   pctx.execute_everyrow();
-  if ( pctx.isrounds() ) pctx.execute_symbol("rounds");
-  if ( !rv ) pctx.execute_symbol("conflict");
+  if ( pctx.isrounds() ) pctx.execute_hook("rounds", pctx.rounds_hook);
+  if ( !rv ) pctx.execute_hook("conflict", pctx.conflict_hook);
   return rv;
 }
 
@@ -142,10 +161,10 @@ proof_context::permute_and_prove()
 
 bool proof_context::isrounds() const 
 {
-  return r == ectx.rounds() && p->count_row(r) == ectx.extents(); 
+  return r == rounds_row && p->count_row(r) == extents; 
 }
 
-void proof_context::execute_symbol( const string& sym, int dir )
+void proof_context::print_lead_head( const string& sym )
 {
   if ( ectx.get_args().show_lead_heads && output && sym != "everyrow" ) {
     if ( ectx.get_args().methods.size() ) {
@@ -161,15 +180,96 @@ void proof_context::execute_symbol( const string& sym, int dir )
     } else
       *output << r << "\t" << sym << endl;
   }
+}
+
+void proof_context::execute_symbol( const string& sym, int dir )
+{
+  print_lead_head(sym);
 
   expression e( dsym_table.lookup(sym) );
   if ( e.isnull() ) e = ectx.lookup_symbol(sym);
   e.execute( *this, dir );
 }
 
+// e is passed by value as executing it might redefine the hook
+void proof_context::execute_hook( const string& sym, expression e )
+{
+  if ( e.isnull() )
+    execute_symbol(sym);
+  else {
+    print_lead_head(sym);
+    e.execute( *this, +1 );
+  }
+}
+
+expression proof_context::find_symbol( const string& sym ) const
+{
+  expression e( dsym_table.lookup(sym) );
+  if ( e.isnull() && ectx.defined(sym) ) e = ectx.lookup_symbol(sym);
+  return e;
+}
+
+void proof_context::lookup_hooks()
+{
+  everyrow_hook = find_symbol("everyrow");
+  rounds_hook   = find_symbol("rounds");
+  conflict_hook = find_symbol("conflict");
+
+  hooks_define_symbols = everyrow_hook.defines_symbols(*this) 
+    || rounds_hook.defines_symbols(*this) 
+    || conflict_hook.defines_symbols(*this);
+}
+
+bool proof_context::symbol_defines_symbols( const string& sym )
+{
+  // A symbol already being checked is checked in full where it was 
+  // first reached, so recursion into it adds nothing.  An undefined 
+  // symbol cannot be executed.
+  if ( !symbols_checked.insert(sym).second ) 
+    return false;
+  expression e( find_symbol(sym) );
+  bool const rv = !e.isnull() && e.defines_symbols(*this);
+  symbols_checked.erase(sym);
+  return rv;
+}
+
+shared_pointer< vector<change> > 
+proof_context::compile( const expression::node* n )
+{
+  // Long blocks are not worth the memory
+  static size_t const max_block_size = 65536u;
+
+  if ( !blocks || hooks_define_symbols ) 
+    return shared_pointer< vector<change> >();
+
+  block_cache::const_iterator i( blocks->find(n) );
+  if ( i != blocks->end() ) 
+    return i->second;
+
+  // Insert a null entry first so that a recursive definition fails
+  shared_pointer< vector<change> >& entry = (*blocks)[n];
+  shared_pointer< vector<change> > block( new vector<change> );
+  if ( n->compile( *this, *block ) && block->size() <= max_block_size )
+    entry = block;
+  return entry;
+}
+
+void proof_context::execute_block( const vector<change>& block, int dir )
+{
+  compiled_rows += block.size();
+  if (dir > 0) 
+    for_each( block.begin(), block.end(), permute_and_prove() );
+  else
+    for_each( block.rbegin(), block.rend(), permute_and_prove() );
+}
+
 void proof_context::define_symbol( const pair<const string, expression>& defn )
 {
   dsym_table.define(defn);
+  if ( blocks ) 
+    blocks.reset( new block_cache );
+  // Even if no hook is redefined, a symbol a hook uses might be
+  lookup_hooks();
 }
 
 proof_context::proof_state proof_context::state() const
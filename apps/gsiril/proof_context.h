@@ -32,6 +32,15 @@
 #else
 #include <iosfwd>
 #endif
+#if RINGING_OLD_INCLUDES
+#include <map.h>
+#include <set.h>
+#include <vector.h>
+#else
+#include <map>
+#include <set>
+#include <vector>
+#endif
 #include <string>
 #include <ringing/row.h>
 #include <ringing/proof.h>
@@ -77,6 +86,23 @@ public:
   void execute_symbol( const string& sym, int dir = +1 );
   void define_symbol( const pair< const string, expression > &defn );
 
+  // The current definition of sym, or a null expression
+  expression find_symbol( const string& sym ) const;
+
+  // Whether executing sym's current definition might define a symbol
+  bool symbol_defines_symbols( const string& sym );
+
+  // The changes that the node always executes, or a null pointer if 
+  // they are not fixed.  Only symbols, lists, reversals and place 
+  // notation are compiled: in particular repeats are not, so that
+  // a break from a hook is caught in the right place.  Nothing is 
+  // compiled while a hook might define a symbol, as that would change 
+  // the rest of a block already running.  The result is cached until 
+  // a symbol is defined during the proof.
+  shared_pointer< vector<change> > compile( const expression::node* n );
+  void execute_block( const vector<change>& block, int dir );
+  size_t compiled_length() const { return compiled_rows; }
+
   enum proof_state { rounds, notround, isfalse };
   proof_state state() const;
   string substitute_string( const string &str, bool &do_exit );
@@ -89,7 +115,17 @@ public:
   void increment_node_count() const;
 
 private:
+  friend struct permute_and_prove_t;
+
   void termination_sequence( ostream& os );
+  void print_lead_head( const string& sym );
+
+  // The symbols executed on each row by permute_and_prove_t are looked 
+  // up when the proof starts and again whenever a symbol is defined, as
+  // that may change whether they might define symbols.  A null 
+  // expression means that the symbol must be looked up when executed.
+  void lookup_hooks();
+  void execute_hook( const string& sym, expression e );
 
   const execution_context &ectx;
   symbol_table dsym_table; // dynamic symbol table
@@ -99,6 +135,18 @@ private:
   ostream* output;
   bool silent;
   bool underline;
+
+  row rounds_row;
+  int extents;
+  expression everyrow_hook, rounds_hook, conflict_hook;
+  bool hooks_define_symbols;
+  set<string> symbols_checked; // Guards symbol_defines_symbols' recursion
+
+  // Shared with silent clones until either defines a symbol
+  typedef map< const expression::node*, shared_pointer< vector<change> > > 
+    block_cache;
+  shared_pointer< block_cache > blocks; // Null if not compiling
+  size_t compiled_rows;
 };
 
 #endif // GSIRIL_PROOF_CONTEXT_INCLUDED
@@ -129,6 +129,10 @@ void prove_stmt::execute( execution_context& e )
           e.set_failure();
 	  break;
 	}
+
+      if ( e.verbose() )
+        e.output() << p.compiled_length() 
+                   << " rows proved from compiled blocks" << endl;
     } 
   catch ( const script_exception& ) 
     {
@@ -196,12 +196,23 @@ private:
     i_evaluate( const method_properties& m ) const 
   {
     row r( arg1->s_evaluate(m) );
-    music mus( m.bells() );
-    mus.push_back( music_details( arg2->s_evaluate(m) ) );
+    string const pattern( arg2->s_evaluate(m) );
+
+    // The pattern is nearly always a literal, so the music is only 
+    // rebuilt when it or the number of bells changes.  Building the 
+    // music's table of matching rows costs far more than the match.
+    if ( pattern != last_pattern || unsigned( m.bells() ) != mus.bells() ) {
+      mus = music( m.bells(), music_details( pattern ) );
+      last_pattern = pattern;
+    }
     return mus.process_row(r);
   }
 
   shared_pointer<expression::node> arg1, arg2;
+
+  // Expressions are never evaluated by two threads at once
+  mutable music mus;
+  mutable string last_pattern;
 };
 
 // Not using i_binary_i_node< std::logical_and<bool> >
@@ -319,10 +330,10 @@ private:
   expression::integer_type i;
 };
 
-class variable_node : public expression::s_node {
+class variable_node : public expression::node {
 public:
   explicit variable_node( const string& str )
-    : num_opt(0)
+    : num_opt(0), int_name(0)
   {
     // Skip the leading dollar
     string::const_iterator begin( str.begin() ), end( str.end() );
@@ -336,6 +347,10 @@ public:
 
     // What's left must be the name
     name.assign( iter, end );
+
+    // Decide now whether i_evaluate can avoid the string round-trip
+    if ( name.size() == 1 && method_properties::is_int_property( name[0] ) )
+      int_name = name[0];
   }
 
 private:
@@ -346,8 +361,18 @@ private:
       return m.get_property( num_opt, name );
   }
 
+  virtual expression::integer_type 
+    i_evaluate( const method_properties& m ) const 
+  {
+    if ( int_name )
+      return m.get_int_property( int_name );
+    else
+      return lexical_cast<expression::integer_type>( s_evaluate(m) );
+  }
+
   int num_opt;
   string name;
+  char int_name; // The name, if it is an integer property; otherwise 0
 };
 
 class exception_node : public expression::node {
@@ -79,6 +79,10 @@ public:
   static RINGING_ULLONG output( ostream &os );
   static void add_entry( const histogram_entry &entry );
 
+  static void set_format( const format_string &f );
+  static void save( ostream &os );
+  static void load( istream &is, int bells );
+
   // Public to avoid MSVC compilation errors
  ~statistics();
 
@@ -95,10 +99,11 @@ private:
 
 class fmtout::impl : public libout::interface {
 public:
-  impl( string const& fmt, string const& filename ) 
+  impl( string const& fmt, string const& filename, bool append ) 
     : fs( fmt, format_string::normal_type ) {
     if ( filename.size() && filename != "-" ) 
-      os.reset( new ofstream( filename.c_str() ) );
+      os.reset( new ofstream( filename.c_str(), 
+                              append ? ios::out | ios::app : ios::out ) );
   }
 
 private:
@@ -107,14 +112,14 @@ private:
     fs.print_method( props, (os ? *os : cout) );
   }
 
-  virtual void flush() {}
+  virtual void flush() { (os ? *os : cout).flush(); }
 
   format_string fs;
   scoped_pointer< ostream > os;
 };
 
-fmtout::fmtout( string const& fmt, string const& filename ) 
-  : libout( new impl( fmt, filename ) ) 
+fmtout::fmtout( string const& fmt, string const& filename, bool append ) 
+  : libout( new impl( fmt, filename, append ) ) 
 {}
 
 class statsout::impl : public libout::interface {
@@ -122,7 +127,9 @@ public:
   explicit impl( string const& fmt )
     : fs( fmt, format_string::stat_type ),
       os( cout )
-  {}
+  {
+    statistics::set_format( fs );
+  }
 
 private:
   virtual void append( library_entry const& entry ) {
@@ -165,67 +172,86 @@ int  formats_max_lead_offset() { return max_lead_offset; }
 class histogram_entry
 {
 public:
-  struct cmp
-  { 
-    typedef bool value_type;
-    typedef histogram_entry first_argument_type;
-    typedef histogram_entry second_argument_type;
-    
-    bool operator()( const histogram_entry &x, 
-		     const histogram_entry &y ) const;
-  };
-
   histogram_entry( const format_string &f, 
 		   const method_properties &m );
 
   void print( ostream &os, RINGING_ULLONG count ) const;
 
+  // Identify the values of the properties being counted.  Where 
+  // method_properties::get_raw_property can, they are identified by 
+  // integers in raw; the rest are formatted into str, each followed by 
+  // a '\0'.  Two entries are counted together if their keys are equal.
+  void key( vector<long>& raw, string& str ) const;
+
+  // The formatted values of all the properties being counted, each 
+  // followed by a '\0'.  The order of these is the order the entries 
+  // are output in.
+  string sort_key() const;
+
+  // The place notation of the method this entry was created from
+  string pn() const { return props.pn(); }
+
+  const method_properties& properties() const { return props; }
+
   RINGING_FAKE_DEFAULT_CONSTRUCTOR( histogram_entry )
 
 private:
-  friend struct cmp;
-
   const format_string &f;
 
   method_properties props;
 };
 
-bool histogram_entry::cmp::operator()( const histogram_entry &x, 
-				       const histogram_entry &y ) const
+RINGING_START_ANON_NAMESPACE
+// These are not taken into account when comparing strings for stats.
+// For '%', '$' and ')' this is because they are constant, and for 'c' 
+// it's because it's still unknown.
+static bool is_counted_property( const string& name )
 {
-  assert( &x.f == &y.f );
+  return !( name == "%" || name == "$" || name == ")" || name == "c" );
+}
+RINGING_END_ANON_NAMESPACE
+
+void histogram_entry::key( vector<long>& raw, string& str ) const
+{
+  raw.clear();  str.clear();
 
   for ( vector< pair<int, string> >::const_iterator 
-	  i( x.f.vars.begin() ), e( x.f.vars.end() );  i != e;  ++i )
+	  i( f.vars.begin() ), e( f.vars.end() );  i != e;  ++i )
     {
-      // These are not taken into account when comparing strings
-      // for stats.  For '%', '$' and ')' this is because they are constant,
-      // and for 'c' it's because it's still unknown.
-      if ( i->second == "%" || i->second == "$" || i->second == ")" 
-	   || i->second == "c" )
+      if ( !is_counted_property( i->second ) )
 	continue;  
 
-      string xval, yval;
-
-      if ( i->second == "*" ) {
-        // TODO: We should cache these in case they contain lengthy 
-        // command invocations and/or non-deterministic output
-	xval = expression_cache::evaluate(i->first, x.props);
-	yval = expression_cache::evaluate(i->first, y.props);
-      }
-      else {
-	xval = x.props.get_property( i->first, i->second );
-	yval = y.props.get_property( i->first, i->second );
-      }
-
-      if ( xval < yval ) 
-	return true;
-      else if ( xval > yval )
-	return false;
+      if ( i->second == "*" )
+	str += expression_cache::evaluate(i->first, props);
+      else if ( i->second.size() == 1 
+                && props.get_raw_property( i->second[0], raw ) )
+        continue;
+      else
+	str += props.get_property( i->first, i->second );
+
+      str += '\0';
     }
+}
 
-  // They're equal
-  return false;
+string histogram_entry::sort_key() const
+{
+  string k;
+
+  for ( vector< pair<int, string> >::const_iterator 
+	  i( f.vars.begin() ), e( f.vars.end() );  i != e;  ++i )
+    {
+      if ( !is_counted_property( i->second ) )
+	continue;  
+
+      if ( i->second == "*" )
+	k += expression_cache::evaluate(i->first, props);
+      else
+	k += props.get_property( i->first, i->second );
+
+      k += '\0';
+    }
+
+  return k;
 }
 
 histogram_entry::histogram_entry( const format_string &f, 
@@ -626,11 +652,138 @@ size_t format_string::parse_requirement( const string& str )
 }
 
 
+RINGING_START_ANON_NAMESPACE
+
+// The frequencies are counted in an open-addressed hash table keyed on
+// histogram_entry::key().  Properties with a raw value are therefore
+// never formatted while counting, and the others only once per method
+// rather than on every comparison in a tree.  The key is built in a
+// buffer that is reused, so nothing is allocated for methods whose 
+// properties have been seen before.  The entries are only formatted 
+// and sorted when they are output.
+class histogram
+{
+public:
+  histogram() : slots( 64u, 0u ) {}
+
+  void add( const histogram_entry& e, RINGING_ULLONG count = 1 ) {
+    e.key( scratch.raw, scratch.str );
+    add( scratch, e.properties(), count );
+  }
+
+  // Add the counts from another histogram into this one.
+  void merge( const histogram& other ) {
+    for ( vector<entry>::const_iterator i( other.entries.begin() ), 
+            e( other.entries.end() );  i != e;  ++i )
+      add( i->k, i->props, i->count );
+  }
+
+  struct key 
+  {
+    vector<long> raw;
+    string str;
+
+    bool operator==( const key& o ) const 
+      { return raw == o.raw && str == o.str; }
+  };
+
+  struct entry
+  {
+    entry( const key& k, const method_properties& props ) 
+      : k(k), props(props), count(0u) {}
+
+    key k;
+    method_properties props;
+    RINGING_ULLONG count;
+  };
+
+  // The entries in the order they were first counted
+  typedef vector<entry>::const_iterator const_iterator;
+  const_iterator begin() const { return entries.begin(); }
+  const_iterator end() const { return entries.end(); }
+
+  // The entries in the order they should be output.
+  vector<entry const*> sorted( const format_string& f ) const;
+
+private:
+  static size_t hash( const key& k ) {
+    size_t h = k.raw.size();
+    for ( vector<long>::const_iterator i( k.raw.begin() ), e( k.raw.end() ); 
+          i != e; ++i )
+      h = hash_combine( h, (unsigned long) *i );
+    for ( string::const_iterator i( k.str.begin() ), e( k.str.end() ); 
+          i != e; ++i )
+      h = hash_combine( h, (unsigned char) *i );
+    return hash_finish(h);
+  }
+
+  void add( const key& k, const method_properties& props, 
+            RINGING_ULLONG count );
+  void rehash();
+
+  vector<entry> entries;
+  vector<size_t> slots;  // Index+1 into entries, or 0 if empty
+  key scratch;           // Reused by add() to avoid allocation
+};
+
+void histogram::add( const key& k, const method_properties& props, 
+                     RINGING_ULLONG count )
+{
+  size_t const mask = slots.size() - 1;
+  size_t i = hash(k) & mask;
+  while ( slots[i] && !( entries[ slots[i] - 1 ].k == k ) )
+    i = (i + 1) & mask;
+
+  if ( !slots[i] ) {
+    entries.push_back( entry( k, props ) );
+    slots[i] = entries.size();
+    entries.back().count += count;
+    if ( 2 * entries.size() > slots.size() ) 
+      rehash();
+  }
+  else
+    entries[ slots[i] - 1 ].count += count;
+}
+
+void histogram::rehash()
+{
+  vector<size_t>( 2 * slots.size(), 0u ).swap( slots );
+  size_t const mask = slots.size() - 1;
+  for ( size_t j = 0; j < entries.size(); ++j ) {
+    size_t i = hash( entries[j].k ) & mask;
+    while ( slots[i] ) i = (i + 1) & mask;
+    slots[i] = j + 1;
+  }
+}
+
+vector<histogram::entry const*> 
+histogram::sorted( const format_string& f ) const
+{
+  // Format each entry just once, and sort on that
+  vector< pair< string, entry const* > > v;
+  v.reserve( entries.size() );
+  for ( vector<entry>::const_iterator i( entries.begin() ), 
+          e( entries.end() );  i != e;  ++i )
+    v.push_back( make_pair( histogram_entry( f, i->props ).sort_key(), 
+                            &*i ) );
+  sort( v.begin(), v.end() );
+
+  vector<entry const*> rv;
+  rv.reserve( v.size() );
+  for ( vector< pair< string, entry const* > >::const_iterator 
+          i( v.begin() ), e( v.end() );  i != e;  ++i )
+    rv.push_back( i->second );
+  return rv;
+}
+
+RINGING_END_ANON_NAMESPACE
+
 struct statistics::impl
 {
-  typedef map< histogram_entry, RINGING_ULLONG, 
-               histogram_entry::cmp > map_type;
-  map_type histogram;
+  impl() : fs( NULL ) {}
+
+  histogram counts;
+  const format_string* fs;
 };
 
 statistics::statistics()
@@ -652,13 +805,13 @@ RINGING_ULLONG statistics::output( ostream &os )
 {
   RINGING_ULLONG count(0ul);
 
-  for ( impl::map_type::const_iterator 
-	  i( instance().histogram.begin() ),
-	  e( instance().histogram.end() );
-	i != e;  ++i )
+  vector<histogram::entry const*> const 
+    v( instance().counts.sorted( *instance().fs ) );
+  for ( vector<histogram::entry const*>::const_iterator 
+          i( v.begin() ), e( v.end() );  i != e;  ++i )
     {
-      i->first.print( os, i->second );
-      count += i->second;
+      histogram_entry( *instance().fs, (*i)->props ).print( os, (*i)->count );
+      count += (*i)->count;
     }
 
   return count;
@@ -669,7 +822,50 @@ void statistics::add_entry( const histogram_entry &entry )
   // Grrr... This is needed because I've got a bug in the code somewhere
   // { make_string ms; entry.print( ms.out_stream(), 0 ); }
 
-  ++instance().histogram[entry];
+  instance().counts.add( entry );
+}
+
+void statistics::set_format( const format_string &f )
+{
+  instance().fs = &f;
+}
+
+// Each entry is saved as its count and the place notation of a method 
+// with those properties, which is enough to recreate it.  Nothing needs
+// formatting, and as they are merged when loaded, the order is irrelevant.
+void statistics::save( ostream &os )
+{
+  for ( histogram::const_iterator i( instance().counts.begin() ), 
+          e( instance().counts.end() );  i != e;  ++i )
+    os << i->count << '\t' << i->props.pn() << '\n';
+}
+
+void statistics::load( istream &is, int bells )
+{
+  RINGING_ULLONG count;  string pn;
+  histogram loaded;
+  while ( is >> count >> pn ) {
+    if ( !instance().fs )
+      throw runtime_error( "Frequencies found without the -H option" );
+
+    method_properties props( method( pn, bells ), string() );
+    loaded.add( histogram_entry( *instance().fs, props ), count );
+  }
+
+  if ( !is.eof() )
+    throw runtime_error( "Unable to read frequencies" );
+
+  instance().counts.merge( loaded );
+}
+
+void save_frequencies( ostream &os )
+{
+  statistics::save( os );
+}
+
+void load_frequencies( istream &is, int bells )
+{
+  statistics::load( is, bells );
 }
 
 void clear_status()
@@ -52,7 +52,9 @@ RINGING_USING_STD
 
 class fmtout : public libout {
 public:
-  explicit fmtout( string const &fmt, string const& filename );
+  // If append is true, an existing file is appended to
+  explicit fmtout( string const &fmt, string const& filename, 
+                   bool append = false );
 
 private:
   class impl;
@@ -128,6 +130,10 @@ size_t parse_requirement( const string& str );
 void clear_status();
 void output_status( const method &m );
 
+// Save and restore the frequencies collected with -H.  
+void save_frequencies( ostream& os );
+void load_frequencies( istream& is, int bells );
+
 void output_count( ostream& out, RINGING_ULLONG count );
 void output_raw_count( ostream& out, RINGING_ULLONG count );
 void output_node_count( ostream& out, RINGING_ULLONG count );
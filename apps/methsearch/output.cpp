@@ -51,6 +51,11 @@
 #else
 #include <ctime>
 #endif
+#if RINGING_OLD_C_INCLUDES
+#include <string.h>
+#else
+#include <cstring>
+#endif
 #include <string>
 #include <ringing/row.h>
 #include <ringing/method.h>
@@ -66,6 +71,10 @@ char const* expr_error_string = "<ERROR>";
 
 static bool formats_in_unicode = false;
 
+// The properties that can be evaluated by get_int_property.  Their
+// values are cached by impl2::ints, in this order.
+static char const int_properties[] = "LbouBMs";
+
 void set_formats_in_unicode(bool val)
 {
   formats_in_unicode = val;
@@ -75,9 +84,11 @@ class method_properties::impl2 : public library_entry::impl
 {
 public:
   explicit impl2( const method& m, const string& payload )
-    : m(m), payload(payload), named(false) {}
+    : m(m), payload(payload), named(false), ints_known(0u) {}
 
   string get_property( int num_opt, const string& name ) const;
+  long get_int_property( char name ) const;
+  bool get_raw_property( char name, vector<long>& key ) const;
 
 private:
   // library_entry::impl interface:
@@ -93,12 +104,16 @@ private:
   { throw runtime_error("Not the value of an input iterator"); }
 
   void lookup() const;
+  const vector<row>& rows() const;
 
   // Data members
   mutable method m;
   const string payload;
   mutable bool named; // Have we looked up the name; not whether it is named
   mutable map< pair< int, string >, string > cache;
+  mutable long ints[ sizeof(int_properties) - 1 ];
+  mutable unsigned ints_known; // Bitmask of the valid entries in ints
+  mutable vector<row> rows_cache; // Created on demand by rows()
 };
 
 string method_properties::impl2::pn() const
@@ -115,6 +130,14 @@ void method_properties::impl2::lookup() const
   }
 }
 
+// The rows of the lead, from rounds to the lead head inclusive
+const vector<row>& method_properties::impl2::rows() const
+{
+  if ( rows_cache.empty() ) 
+    rows_cache = row_block( m, row( m.bells() ) );
+  return rows_cache;
+}
+
 method method_properties::impl2::meth() const
 {
   if (!named) lookup();
@@ -133,6 +156,78 @@ string method_properties::impl2::base_name() const
   return m.name();
 }
 
+long method_properties::impl2::get_int_property( char prop_name ) const
+{
+  // Not cached as it changes
+  if ( prop_name == '?' ) 
+    return get_last_exec_status();
+
+  char const* p = prop_name ? strchr( int_properties, prop_name ) : NULL;
+  if ( !p ) 
+    throw logic_error( "Unknown integer variable requested" );
+
+  size_t const i = p - int_properties;
+  if ( !( ints_known & (1u << i) ) ) 
+    {
+      switch ( prop_name )
+	{
+	case 'L': ints[i] = m.size();                      break;
+	case 'b': ints[i] = m.maxblows();                  break;
+	case 'o': ints[i] = m.leads();                     break;
+	case 'u': ints[i] = m.huntbells();                 break;
+	case 'B': ints[i] = m.bells();                     break;
+	case 'M': ints[i] = musical_analysis::analyse(m);  break;
+	case 's': ints[i] = staticity(m);                  break;
+	}
+      ints_known |= 1u << i;
+    }
+
+  return ints[i];
+}
+
+bool method_properties::impl2::get_raw_property( char prop_name, 
+                                                vector<long>& key ) const
+{
+  switch ( prop_name )
+    {
+    case 'L': case 'b': case 'o': case 'u': case 'B': case 'M': case 's':
+      key.push_back( get_int_property( prop_name ) );
+      return true;
+
+    case 'l': {
+      row const lh( m.lh() );
+      key.push_back( lh.bells() );
+      for ( int i=0; i<lh.bells(); ++i ) 
+        key.push_back( lh[i] );
+    } return true;
+
+    case 'y': {
+      // The string is short enough not to be allocated
+      string const sym( method_symmetry_string( m ) );
+      long flags = 0;
+      for ( string::const_iterator i( sym.begin() ), e( sym.end() ); 
+            i != e; ++i )
+        flags |= 1l << ( strchr( "PMGR", *i ) - "PMGR" );
+      key.push_back( flags );
+    } return true;
+
+    case 'C': {
+      // Unknown and principle have the same empty class name
+      int cl = m.methclass();
+      if ( ( cl & method::M_MASK ) == method::M_PRINCIPLE ) 
+        cl = ( cl & ~method::M_MASK ) | method::M_UNKNOWN;
+      key.push_back( cl );
+    } return true;
+
+    case 'S':
+      key.push_back( m.bells() );
+      return true;
+
+    default:
+      return false;
+    }
+}
+
 string method_properties::impl2::get_property( int num_opt, 
 					       const string& prop_name ) const
 {
@@ -153,12 +248,12 @@ string method_properties::impl2::get_property( int num_opt,
     {
       switch ( prop_name[0] ) 
 	{
-	case 'L':
-	  os << setw(num_opt) << m.size();
+	case 'L': case 'b': case 'o': case 'u': case 'B': case 'M': case 's':
+	  os << setw(num_opt) << get_int_property( prop_name[0] );
 	  break;
 	  
 	case 'l': 
-	  os << m.lh();
+	  os << rows().back();
 	  break;
 
 	case 'p': 
@@ -175,18 +270,11 @@ string method_properties::impl2::get_property( int num_opt,
                           method::M_OMIT_LH );
 	  break;
 
-	case 'r': {
-	  // TODO:  Should we cache all rows at same time?
-	  row r( m.bells() );
-	  int n( num_opt );
-	  for ( method::const_iterator 
-		  i( m.begin() ), e( m.begin() + num_opt );
-		n && i != e; ++i, --n ) 
-	    r *= *i;
-	  if ( n )
+	case 'r':
+	  if ( num_opt > int( m.size() ) )
 	    throw runtime_error( "Format specifies row after end of method" );
-	  os << r;
-	} break;
+	  os << rows()[num_opt];
+	  break;
 
 	case 'h': 
 	  try { 
@@ -197,22 +285,6 @@ string method_properties::impl2::get_property( int num_opt,
           }
 	  break;
 
-	case 'b': 
-	  os << setw(num_opt) << m.maxblows();
-	  break;
-
-	case 'o': 
-	  os << setw(num_opt) << m.leads();
-	  break;
-
-	case 'u': 
-	  os << setw(num_opt) << m.huntbells(); 
-	  break;
-
-	case 'B': 
-	  os << setw(num_opt) << m.bells(); 
-	  break;
-
 	case 'd': 
 	  os << m.lhcode(); 
 	  break;
@@ -241,10 +313,6 @@ string method_properties::impl2::get_property( int num_opt,
 	  os << method::stagename( m.bells() );
 	  break;
 
-	case 'M': 
-	  os << setw(num_opt) << musical_analysis::analyse(m);
-	  break;
-
 	case 'F': 
 	  os << falseness_group_codes(m);
 	  break;
@@ -259,10 +327,6 @@ string method_properties::impl2::get_property( int num_opt,
 	  os << tenors_together_coursing_order(m);
 	  break;
 
-        case 's':
-          os << setw(num_opt) << staticity(m);
-          break;
-
 	case '#': {
 	  static RINGING_ULLONG n=0;
 	  os << setw(num_opt) << ++n;
@@ -334,6 +398,22 @@ method_properties::method_properties( const library_entry& le )
   }
 }
 
+bool method_properties::is_int_property( char name )
+{
+  return name == '?' || ( name && strchr( int_properties, name ) );
+}
+
+long method_properties::get_int_property( char name ) const
+{
+  return get_impl( (impl2*)NULL )->get_int_property( name );
+}
+
+bool method_properties::get_raw_property( char name, 
+                                          vector<long>& key ) const
+{
+  return get_impl( (impl2*)NULL )->get_raw_property( name, key );
+}
+
 string method_properties::get_property( int num_opt, const string& name ) const
 {
   // MSVC 6.0 has issues with the get_impl<impl>() syntax  
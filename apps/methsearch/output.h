@@ -27,6 +27,11 @@
 #pragma interface
 #endif
 
+#if RINGING_OLD_INCLUDES
+#include <vector.h>
+#else
+#include <vector>
+#endif
 #include <string>
 #include <ringing/library.h>
 
@@ -43,6 +48,17 @@ public:
 
   string get_property( int num_opt, const string& name ) const;
 
+  // Some properties are integers, and these can be read directly without 
+  // formatting them as strings.  The field width does not affect the value.
+  static bool is_int_property( char name );
+  long get_int_property( char name ) const;
+
+  // Some properties can be identified by a few integers without 
+  // formatting them.  For these, the integers are appended to key and 
+  // true is returned; two methods append the same integers just when 
+  // the formatted properties are equal.  Otherwise nothing is appended.
+  bool get_raw_property( char name, vector<long>& key ) const;
+
 private:
   class impl2;
 };
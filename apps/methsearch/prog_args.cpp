@@ -27,6 +27,7 @@
 #include <ringing/row.h>
 #include <ringing/streamutils.h>
 #include <ringing/xmlout.h>
+#include <ringing/thread.h>
 #include "args.h"
 #include "prog_args.h"
 #include "libraries.h"
@@ -468,6 +469,27 @@ void arguments::bind( arg_parser &p )
            "Time the search out after NUM seconds", "NUM",
            timeout ) );
 
+  p.add( new integer_opt
+         ( '\0', "threads",
+           "Run the search using NUM threads (0 = one per processor)", 
+           "NUM",
+           threads ) );
+
+  p.add( new string_opt
+         ( '\0', "checkpoint",
+           "Periodically save the state of the search to FILE", "FILE",
+           checkpoint_file ) );
+
+  p.add( new integer_opt
+         ( '\0', "checkpoint-interval",
+           "Save the state of the search every NUM seconds", "NUM",
+           checkpoint_interval ) );
+
+  p.add( new boolean_opt
+         ( '\0', "resume",
+           "Resume the search from the file given to --checkpoint",
+           resume ) );
+
   p.add( new boolean_opt
 	 ( 'P', "parity-hack",
 	   "Require an equal number of rows of each parity for each place "
@@ -794,6 +816,43 @@ bool arguments::validate( arg_parser &ap )
     return false;
   }
 
+  if ( threads < 0 ) {
+    ap.error( "The number of threads must not be negative" );
+    return false;
+  }
+  if ( threads == 0 ) 
+    threads = hardware_concurrency();
+  if ( threads > 1 && ( random_order || filter_mode || filter_lib_mode ) ) {
+    ap.error( "--threads cannot be used with --random or when filtering" );
+    return false;
+  }
+
+  if ( checkpoint_file.size() ) {
+    if ( threads > 1 || random_order || filter_mode || filter_lib_mode ) {
+      ap.error( "--checkpoint cannot be used with --threads, --random "
+                "or when filtering" );
+      return false;
+    }
+    if ( checkpoint_interval < 1 ) {
+      ap.error( "The checkpoint interval must be at least one second" );
+      return false;
+    }
+  }
+  if ( resume ) {
+    if ( checkpoint_file.empty() ) {
+      ap.error( "--resume requires a --checkpoint file" );
+      return false;
+    }
+    if ( startmethstr.size() ) {
+      ap.error( "--resume cannot be used with --start-at" );
+      return false;
+    }
+    if ( outfmt == "xml" ) {
+      ap.error( "--resume cannot be used with -Oxml" );
+      return false;
+    }
+  }
+
   if ( outfmt == "utf8" ) 
     set_formats_in_unicode( true );
 
@@ -803,7 +862,7 @@ bool arguments::validate( arg_parser &ap )
 	outfmt.erase();
 	if ( R_fmt_str.empty() )
           R_fmt_str = filter_mode ? "$p\t$a" : "$p\t$l";
-	outputs.add( new fmtout( R_fmt_str, outfile ) );
+	outputs.add( new fmtout( R_fmt_str, outfile, resume ) );
       } 
       else if ( outfmt == "xml" ) {
         if ( outfile.empty() || outfile == "-" ) { 
@@ -960,7 +1019,7 @@ bool arguments::validate( arg_parser &ap )
 
   if ( pends_generators.size() ) 
   {
-    pends = group( pends_generators );
+    pends = group( pends_generators, group::chained );
     set<row> x;
     for ( set<row>::const_iterator i=avoid_rows.begin(), e=avoid_rows.end();
             i != e; ++i )
@@ -96,6 +96,10 @@ struct arguments
   init_val<bool,false> filter_lib_mode;
   init_val<bool,false> invert_filter;
   init_val<int, 0>     timeout;
+  init_val<int, 1>     threads;
+  string               checkpoint_file;
+  init_val<int, 300>   checkpoint_interval;
+  init_val<bool,false> resume;
 
   init_val<bool,false> no_78_pns;
   init_val<bool,false> sym_sects;
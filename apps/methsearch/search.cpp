@@ -35,21 +35,43 @@
 #include "libraries.h" // for filter_lib code
 #if RINGING_OLD_INCLUDES
 #include <vector.h>
+#include <map.h>
 #include <algo.h>
+#include <stdexcept.h>
 #else
 #include <vector>
+#include <map>
 #include <algorithm>
+#include <stdexcept>
+#endif
+#if RINGING_HAVE_OLD_IOSTREAMS
+#include <iostream.h>
+#include <fstream.h>
+#else
+#include <iostream>
+#include <fstream>
 #endif
 #if RINGING_OLD_C_INCLUDES
 #include <assert.h>
 #include <math.h>
 #include <string.h>
 #include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
 #else
 #include <cassert>
 #include <cmath>
 #include <cstring>
 #include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#endif
+#if RINGING_WINDOWS && !defined(__CYGWIN__)
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
 #endif
 #include <ringing/row.h>
 #include <ringing/method.h>
@@ -58,15 +80,51 @@
 #include <ringing/mathutils.h>
 #include <ringing/litelib.h>
 #include <ringing/falseness.h>
+#include <ringing/thread.h>
+#include <ringing/pointers.h>
+#include <ringing/streamutils.h>
 
 
 RINGING_USING_NAMESPACE
 RINGING_USING_STD
 
+// Locks the mutex, if there is one.  A searcher only has a mutex when 
+// the search is split between several threads.
+class optional_lock
+{
+public:
+  explicit optional_lock( mutex* m ) : m(m) { if (m) m->lock(); }
+ ~optional_lock() { if (m) m->unlock(); }
+
+private:
+  // Unimplemented
+  optional_lock( optional_lock const& );
+  optional_lock& operator=( optional_lock const& );
+
+  mutex* m;
+};
+
+// A subtree of the search, identified by the changes leading to it,
+// that can be searched independently of the rest of the search.
+struct search_job
+{
+  explicit search_job( method const& prefix )
+    : prefix( prefix ), nodes( 0ul ), done( false ), complete( false )
+  {}
+
+  method prefix;
+
+  vector<method> found;      // Methods found, in the order found
+  RINGING_ULLONG nodes;
+  bool done;
+  bool complete;             // False if halted part way through 
+};
+
 class searcher
 {
 private:
   friend void run_search( const arguments &args );
+  friend class parallel_search;
 
   searcher( const arguments &args );
   void reset();
@@ -74,6 +132,10 @@ private:
   inline void do_status( method const& m );
   void filter( library const& );
   void general_recurse();
+  void run_job( search_job& job );
+
+  void write_checkpoint( bool finished = false );
+  bool read_checkpoint();
 
   inline bool push_change( const change& ch);
   inline void pop_change( row const* r_old = NULL );
@@ -120,7 +182,7 @@ private:
   RINGING_ULLONG search_count;
   RINGING_ULLONG node_count;
 
-  vector<change> startmeth;
+  method startmeth;  // Where the search starts, e.g. from --start-at
   method filter_method;
   string filter_payload;
   size_t div_start;  // The index (into m) of the row of the division
@@ -129,7 +191,20 @@ private:
   bool maintain_r;   // Whether r is valid
   row r;
   scoped_pointer<prover> prv;
+  bool maintain_rows;  // Whether rows is valid
+  vector<row> rows;    // rows[i] is the row after the first i changes of m
+  map<row, string> fch_symbols; // Cache of false_courses::lookup_symbol
   time_t start;
+
+  size_t level;      // The number of calls to general_recurse in progress
+  time_t last_checkpoint;
+
+  // Only used when the search is split between several threads
+  vector<search_job>* jobs;  // If set, collect subtrees here
+  size_t split_depth;        // ... at this depth
+  vector<method>* found;     // If set, store methods here, not output them
+  mutex* shared;             // Protects state shared between threads
+  volatile bool const* halted;
 };
 
 
@@ -144,19 +219,27 @@ searcher::searcher( const arguments &args )
     search_count( 0ul ), node_count( 0ul ),
     div_start( 0 ), cur_div_len( calc_cur_div_len() ),
     r( args.pends.rcoset_label( args.start_row ) ),
-    maintain_r( args.avoid_rows.size() )
+    maintain_r( args.avoid_rows.size() ),
+    maintain_rows( args.allowed_falseness.size() || args.require_CPS ),
+    level( 0 ),
+    jobs( NULL ), split_depth( 0 ), found( NULL ), shared( NULL ),
+    halted( NULL )
 {
   reset();
+  last_checkpoint = start;
 
-  copy( args.startmeth.rbegin(), args.startmeth.rend(), 
-        back_inserter(startmeth) );
-
+  startmeth = args.startmeth;
 }
 
 void searcher::reset()
 {
   m.clear();
   m.reserve( lead_len );
+  if (maintain_rows) {
+    rows.clear();
+    rows.reserve( lead_len + 1 );
+    rows.push_back( row(bells) );
+  }
   div_start = 0; cur_div_len = calc_cur_div_len();
 
   if (maintain_r) 
@@ -167,7 +250,7 @@ void searcher::reset()
        args.true_half_lead && ( args.pends.size() > 1 ||
          args.hunt_bells == 0 || args.treble_dodges > 1 ) ) 
   {
-    prv.reset( new prover(1) ); // XXX n_extents
+    prv.reset( new prover( 1, prover::automatic_storage ) ); // XXX n_extents
     for ( set<row>::const_iterator 
             i=args.avoid_rows.begin(), e=args.avoid_rows.end(); i != e; ++i )
       prv->add_row(*i);
@@ -181,9 +264,12 @@ void searcher::reset()
 
 inline void searcher::do_status( method const& m ) {
   if ( node_count % args.status_freq == 0 ) {
-    if ( args.status ) output_status(m);
+    if ( args.status ) { optional_lock l( shared ); output_status(m); }
     if ( args.timeout && time(NULL) - start > args.timeout ) 
       throw timeout_exception();
+    if ( args.checkpoint_file.size() 
+         && time(NULL) - last_checkpoint >= args.checkpoint_interval )
+      write_checkpoint();
   }
   ++node_count;
 }
@@ -230,9 +316,310 @@ void searcher::filter( library const& in )
     } 
 }
 
+void searcher::run_job( search_job& job )
+{
+  found = &job.found;
+  search_count = node_count = 0ul;
+
+  // Each change was accepted when the job was created, so they 
+  // will be accepted again.
+  for ( method::const_iterator i=job.prefix.begin(), e=job.prefix.end(); 
+        i != e; ++i ) 
+    if ( !push_change(*i) ) 
+      assert( false );
+
+  try {
+    general_recurse();
+  }
+  catch ( ... ) {
+    while ( m.length() ) pop_change();
+    job.nodes = node_count;
+    throw;
+  }
+  
+  while ( m.length() ) pop_change();
+  job.nodes = node_count;
+}
+
+// The search is split into jobs at a fixed depth which are searched 
+// by a pool of threads, each with its own searcher.  Methods found are
+// held in the job until every earlier job has been output, so the 
+// methods are output in exactly the same order as in a serial search.
+class parallel_search
+{
+public:
+  parallel_search( searcher& s, unsigned threads )
+    : s(s), threads(threads), next_job(0), next_output(0), 
+      count(0ul), halted(false)
+  {}
+
+  void run();
+
+private:
+  class worker : public thread_task
+  {
+  public:
+    worker( parallel_search& p ) : p(p), s(p.s.args) {}
+
+  private:
+    virtual void run();
+
+    parallel_search& p;
+    searcher s;
+  };
+
+  void collect_jobs();
+  void output_jobs();
+
+  searcher& s;
+  unsigned threads;
+
+  vector<search_job> jobs;
+  mutex lock;
+  size_t next_job, next_output;
+  RINGING_ULLONG count;
+  volatile bool halted;
+};
+
+void parallel_search::collect_jobs()
+{
+  // Look for enough subtrees to keep all of the threads busy, even if 
+  // they are of very uneven sizes.  The nodes above the split are
+  // counted here; those below it, by the workers.
+  size_t const lead_len = s.lead_len;
+  size_t depth = 0;
+  do {
+    searcher c( s.args );
+    jobs.clear();
+    c.jobs = &jobs;  c.split_depth = ++depth;
+    c.general_recurse();
+    assert( c.m.length() == 0 );
+    s.node_count = c.node_count;
+  } while ( jobs.size() < 64 * threads && depth < lead_len );
+}
+
+void parallel_search::output_jobs()
+{
+  // Must be called with the lock held
+  bool const limited = s.search_limit && s.search_limit != -1;
+
+  while ( !halted && next_output < jobs.size() && jobs[next_output].done ) 
+    {
+      search_job& j = jobs[next_output++];
+      for ( vector<method>::const_iterator 
+              i = j.found.begin(), e = j.found.end(); i != e; ++i ) {
+        if ( limited && count == s.search_limit ) break;
+        s.output_method(*i);
+        ++count;
+      }
+      vector<method>().swap( j.found );
+
+      // Nothing after a job that was halted can be output
+      if ( !j.complete || limited && count == s.search_limit ) 
+        halted = true;
+    }
+}
+
+void parallel_search::worker::run()
+{
+  s.shared = &p.lock;  s.halted = &p.halted;  s.start = p.s.start;
+
+  while (true) {
+    search_job* j;
+    {
+      mutex::scoped_lock l( p.lock );
+      if ( p.halted || p.next_job == p.jobs.size() ) 
+        return;
+      j = &p.jobs[ p.next_job++ ];
+    }
+
+    bool complete = true;
+    try {
+      s.run_job( *j );
+    } 
+    catch ( const exit_exception& ) { complete = false; }
+    catch ( const timeout_exception& ) { complete = false; }
+
+    mutex::scoped_lock l( p.lock );
+    j->done = true;
+    j->complete = complete && !p.halted;
+    p.s.node_count += j->nodes;
+    p.output_jobs();
+    if ( !complete ) p.halted = true;
+  }
+}
+
+void parallel_search::run()
+{
+  collect_jobs();
+
+  vector< shared_pointer<worker> > workers;
+  vector<thread_task*> tasks;
+  for ( unsigned i = 0; i < threads; ++i ) {
+    workers.push_back( shared_pointer<worker>( new worker(*this) ) );
+    tasks.push_back( workers.back().get() );
+  }
+
+  try {
+    run_threads( tasks );
+  }
+  catch (...) {
+    s.search_count = count;
+    throw;
+  }
+
+  s.search_count = count;
+}
+
+// A checkpoint is written at the start of a node, before it is counted,
+// and records the changes leading to that node.  Resuming from it searches
+// that node and the ones leading to it again, so the node count saved
+// excludes the nodes leading to it.  It also records the length of the 
+// -o output file, which is cut back to that length when resuming, so
+// that methods written after the checkpoint are not written twice.
+
+RINGING_START_ANON_NAMESPACE
+
+void read_checkpoint_field( istream& is, char const* name )
+{
+  string s;
+  if ( !(is >> s) || s != name ) 
+    throw runtime_error( make_string() << "Expected '" << name << "'" );
+}
+
+// The file methods are being written to, or an empty string if they are
+// written to standard output or not at all
+string output_file( const arguments& args )
+{
+  if ( args.quiet || args.outfile == "-" ) return string();
+  return args.outfile;
+}
+
+RINGING_ULLONG file_length( const string& filename )
+{
+  ifstream is( filename.c_str(), ios::in | ios::binary );
+  is.seekg( 0, ios::end );
+  if ( !is ) 
+    throw runtime_error( make_string() << "Unable to read " << filename );
+  return is.tellg();
+}
+
+void truncate_file( const string& filename, RINGING_ULLONG len )
+{
+  if ( file_length( filename ) < len )
+    throw runtime_error( make_string() << filename << " is shorter than "
+                         "when the checkpoint was written" );
+#if RINGING_WINDOWS && !defined(__CYGWIN__)
+  int fd = _open( filename.c_str(), _O_RDWR );
+  bool ok = fd != -1 && _chsize( fd, long(len) ) == 0;
+  if ( fd != -1 ) _close(fd);
+#else
+  bool ok = truncate( filename.c_str(), off_t(len) ) == 0;
+#endif
+  if ( !ok ) 
+    throw runtime_error( make_string() << "Unable to truncate " << filename );
+}
+
+RINGING_END_ANON_NAMESPACE
+
+void searcher::write_checkpoint( bool finished )
+{
+  string const tmp( args.checkpoint_file + ".tmp" );
+  string const outfile( output_file(args) );
+
+  // Everything output so far must be in the file before its length is 
+  // recorded
+  args.outputs.flush();
+
+  {
+    ofstream os( tmp.c_str() );
+    os << "methsearch-checkpoint\n"
+       << "bells " << bells << "\n"
+       << "finished " << finished << "\n";
+
+    os << "changes " << ( finished ? 0 : m.size() );
+    if ( !finished )
+      for ( method::const_iterator i = m.begin(), e = m.end(); i != e; ++i )
+        os << ' ' << i->print();
+    os << "\n";
+
+    os << "methods " << search_count << "\n"
+       << "nodes " << ( finished ? node_count : node_count - level ) << "\n"
+       << "output " << ( outfile.size() ? file_length(outfile) : 0 ) << "\n"
+       << "frequencies\n";
+    save_frequencies( os );
+
+    if ( !os ) {
+      cerr << "Unable to write checkpoint to " << tmp << "\n";
+      return;
+    }
+  }
+
+  // Replace the old checkpoint in one go, so that there is always
+  // a complete one to resume from.
+  if ( rename( tmp.c_str(), args.checkpoint_file.c_str() ) != 0 )
+    cerr << "Unable to write checkpoint to " 
+         << args.checkpoint_file << "\n";
+
+  last_checkpoint = time(NULL);
+}
+
+bool searcher::read_checkpoint()
+{
+  ifstream is( args.checkpoint_file.c_str() );
+
+  // If there is no checkpoint yet, start from the beginning
+  if ( !is ) return true;
+
+  bool finished;
+  try {
+    read_checkpoint_field( is, "methsearch-checkpoint" );
+    
+    int b;
+    read_checkpoint_field( is, "bells" );  is >> b;
+    if ( is && b != bells ) 
+      throw runtime_error( "The checkpoint is for a different "
+                           "number of bells" );
+
+    read_checkpoint_field( is, "finished" );  is >> finished;
+
+    size_t n;
+    read_checkpoint_field( is, "changes" );  is >> n;
+    method path;
+    for ( size_t i = 0; is && i < n; ++i ) {
+      string ch;  is >> ch;
+      path.push_back( change( bells, ch ) );
+    }
+
+    read_checkpoint_field( is, "methods" );  is >> search_count;
+    read_checkpoint_field( is, "nodes" );  is >> node_count;
+    RINGING_ULLONG outlen;
+    read_checkpoint_field( is, "output" );  is >> outlen;
+    read_checkpoint_field( is, "frequencies" );
+    if ( !is ) 
+      throw runtime_error( "Malformed checkpoint" );
+
+    // The output file has already been opened for appending
+    string const outfile( output_file(args) );
+    if ( outfile.size() ) 
+      truncate_file( outfile, outlen );
+
+    load_frequencies( is, bells );
+    startmeth = path;
+  }
+  catch ( exception const& e ) {
+    cerr << "Unable to resume from checkpoint " << args.checkpoint_file 
+         << ": " << e.what() << "\n";
+    exit(1);
+  }
+
+  return !finished;
+}
+
 void run_search( const arguments &args )
 {
   searcher s( args );
+  bool timed_out = false;
 
   try 
     {
@@ -251,13 +638,19 @@ void run_search( const arguments &args )
           s.reset();
           if (s.search_count >= args.search_limit) break;
         }
-      } else {
+      } else if ( args.threads > 1 ) {
+        parallel_search( s, args.threads ).run();
+      } else if ( !args.resume || s.read_checkpoint() ) {
         s.general_recurse();
         assert( s.m.length() == 0 );
       }
     } 
   catch ( const exit_exception& ) {}
-  catch ( const timeout_exception& ) {}
+  catch ( const timeout_exception& ) { timed_out = true; }
+
+  // If the search timed out, it can be resumed from where it got to
+  if ( args.checkpoint_file.size() )
+    s.write_checkpoint( !timed_out );
  
   if ( args.status ) clear_status();
 
@@ -280,6 +673,11 @@ void run_search( const arguments &args )
 
 void searcher::output_method( method const& meth )
 {
+  if ( found ) {
+    found->push_back( meth );
+    return;
+  }
+
   if ( !args.outputs.empty() ) {
     method_properties props( meth, filter_payload );
 
@@ -346,16 +744,25 @@ private:
     assert( p.truth() );
   }
 
+  // A prover2 is created for every method tested, so only use a bitset 
+  // of the extent where it is cheap to create.
+  static prover::storage_type storage( arguments const& args ) {
+    return args.bells <= 8 ? prover::automatic_storage : prover::hash_storage;
+  }
+
 public:
   prover2( arguments const& args ) 
-   : args(args), n_extents(1), p(n_extents), r(args.start_row) { init(); }
+   : args(args), n_extents(1), p(n_extents, storage(args)), 
+     r(args.start_row) { init(); }
 
   prover2( arguments const& args, row const& r ) 
-   : args(args), n_extents(1), p(n_extents), r(r) { init(); }
+   : args(args), n_extents(1), p(n_extents, storage(args)), 
+     r(r) { init(); }
 
   struct raw {};
   prover2( arguments const& args, raw )
-    : args(args), n_extents(1), p(n_extents), r(args.bells)
+    : args(args), n_extents(1), p(n_extents, storage(args)), 
+      r(args.bells)
   {}
 
   bool prove( method::const_iterator i, method::const_iterator e ) {
@@ -368,7 +775,7 @@ public:
 
   bool prove_lh( row const& lh ) {
     row const r2 = args.pends.rcoset_label(lh);
-    if ( r2 != args.start_row )
+    if ( r2 != args.pends.rcoset_label(args.start_row) )
       p.add_row(r2);
     return p.truth();
   }
@@ -398,7 +805,7 @@ private:
 bool searcher::is_acceptable_method()
 {
   if ( lexicographical_compare( m.begin(), m.end(), 
-           args.startmeth.begin(), args.startmeth.end(),
+           startmeth.begin(), startmeth.end(),
            compare_changes ) )
     return false;
 
@@ -471,20 +878,33 @@ bool searcher::is_acceptable_method()
          && ( args.pends.size() > 1 
               || !( args.sym && args.hunt_bells && !args.treble_dodges ) ) )
     {
-      prover2 p(args);
-      while ( p.prove(m.begin(), m.end()) &&
-              args.true_course && !p.is_course_head() )
-        ;
-
-      if ( !args.true_course )  // i.e. if -Fl
-        assert( p.truth() );
-
-      // There doesn't seem any ideal solution as to what to do with the 
-      // lead head row.  Arguably we shouldn't prove it as it's not 
-      // part of the lead.  But that leads to odd things in -AU0 searches
-      // where we're just looking for a block of rows.  So lets require that 
-      // either it is true or it is the first row again.
-      if ( !p.prove_lh() ) return false;
+      // If the rows have been proved one at a time as the changes were
+      // pushed, the lead is known to be true and only the lead head 
+      // remains to be checked.
+      if ( prv && !args.true_course ) {
+        row const st( args.pends.rcoset_label( args.start_row ) );
+        if ( r != st ) {
+          bool const ok = prv->add_row(r);
+          prv->remove_row(r);
+          if (!ok) return false;
+        }
+      }
+      else {
+        prover2 p(args);
+        while ( p.prove(m.begin(), m.end()) &&
+                args.true_course && !p.is_course_head() )
+          ;
+
+        if ( !args.true_course )  // i.e. if -Fl
+          assert( p.truth() );
+
+        // There doesn't seem any ideal solution as to what to do with the 
+        // lead head row.  Arguably we shouldn't prove it as it's not 
+        // part of the lead.  But that leads to odd things in -AU0 searches
+        // where we're just looking for a block of rows.  So lets require that 
+        // either it is true or it is the first row again.
+        if ( !p.prove_lh() ) return false;
+      }
     }
 
   // Although treble-dodging methods with more than one dodge can run
@@ -537,12 +957,20 @@ bool searcher::is_acceptable_method()
     return false;
 
   // Leave this one last as --requires does a fork and so is very expensive
-  for ( vector<size_t>::const_iterator 
-          i = args.require_expr_idxs.begin(), e = args.require_expr_idxs.end(); 
-        i != e; ++i ) {
+  // The expressions may use caches that are shared between threads.
+  // The same properties object is used for each expression so that
+  // any property needed by several of them is only calculated once.
+  // The status of any command run by one expression is not visible 
+  // to the next.
+  if ( args.require_expr_idxs.size() ) {
+    optional_lock l( shared );
     method_properties props(m, filter_payload);
-    if ( !expression_cache::b_evaluate( *i, props ) )
-      return false;
+    for ( vector<size_t>::const_iterator i = args.require_expr_idxs.begin(), 
+            e = args.require_expr_idxs.end();  i != e;  ++i ) {
+      if ( !expression_cache::b_evaluate( *i, props ) )
+        return false;
+      clear_last_exec_status();
+    }
   }
 
   return true;
@@ -551,6 +979,8 @@ bool searcher::is_acceptable_method()
 inline bool searcher::push_change( const change& ch )
 {
   m.push_back( ch );
+  if ( maintain_rows ) 
+    rows.push_back( rows.back() * ch );
   if ( maintain_r ) {
     r = args.pends.rcoset_label( r * ch );
     // We don't care about the lead head row.
@@ -574,6 +1004,8 @@ inline bool searcher::push_change( const change& ch )
 inline void searcher::pop_change( row const* r_old )
 {
   m.pop_back();
+  if ( maintain_rows ) 
+    rows.pop_back();
   if (div_start > m.length()) {
      div_start -= cur_div_len;
      cur_div_len = calc_cur_div_len();
@@ -1008,7 +1440,7 @@ cerr << "SOUP: " << ch << " at depth " << m.length() << endl;
 
 bool searcher::is_falseness_acceptable( const change& ch )
 {
-  row r( args.bells ); for_each( m.begin(), m.end() - 1, permute(r) );
+  row const& r = rows[ m.size() - 1 ];
   row c; c *= m.back(); c *= ch;
 
   // 1 contains 1.r and 1.r.c
@@ -1018,7 +1450,14 @@ bool searcher::is_falseness_acceptable( const change& ch )
   row x = r * c * r.inverse();
 
   assert( x[0] == 0 );
-  string sym( false_courses::lookup_symbol(x) );
+  map<row, string>::const_iterator si = fch_symbols.find(x);
+  if ( si == fch_symbols.end() ) {
+    // The symbol table is shared between threads
+    optional_lock l( shared );
+    si = fch_symbols.insert
+      ( make_pair( x, false_courses::lookup_symbol(x) ) ).first;
+  }
+  string const& sym = si->second;
   assert( args.bells != 8 || sym.size() );
   if ( args.allowed_falseness.size() ) {
     if ( sym == "A" || sym.empty() ) return true;
@@ -1091,13 +1530,12 @@ void searcher::new_midlead_change()
                     random_number_generator );
   }
 
-  // If we're starting at a particular point (with --start), find out
-  // what that change is.
+  // If we're starting at a particular point (with --start-at), and
+  // haven't yet left the path to it, find out what the next change is.
   change first;
-  if ( startmeth.size() ) {
-    first = startmeth.back();
-    startmeth.pop_back();
-  }
+  if ( depth < startmeth.size() 
+       && equal( m.begin(), m.end(), startmeth.begin() ) )
+    first = startmeth[depth];
 
   for ( vector<change>::const_iterator 
           i( changes_to_try.begin() ), e( changes_to_try.end() ); 
@@ -1284,8 +1722,19 @@ void searcher::general_recurse()
        search_count == search_limit )
     return;
 
+  if ( halted && *halted )
+    return;
+
+  // When splitting the search between threads, stop at the split depth
+  // and leave the subtree to be searched later.
+  if ( jobs && depth >= split_depth ) {
+    jobs->push_back( search_job(m) );
+    return;
+  }
+
   // Status message (when in search mode)
   if ( !args.filter_mode ) do_status(m);
+  ++level;
 
   // XXX ALLIANCE Is the lead_len % 4 test valid? 
   const bool has_qlead_change = lead_len % 4 == 0;
@@ -1404,4 +1853,6 @@ void searcher::general_recurse()
     {
       new_midlead_change();
     }
+
+  --level;
 }
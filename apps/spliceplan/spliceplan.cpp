@@ -29,6 +29,7 @@
 #include <ringing/multtab.h>
 #include <ringing/mathutils.h>
 #include <ringing/streamutils.h>
+#include <ringing/thread.h>
 
 #include "args.h"
 
@@ -38,10 +39,12 @@
 #include <map>
 #include <fstream>
 #include <set>
+#include <sstream>
 #include <utility>
 #include <vector>
 
 #include <cassert>
+#include <climits>
 
 #if RINGING_DEBUG_FILE
 #define DEBUG( expr ) (void)((cout << expr) << endl)
@@ -241,6 +244,9 @@ struct arguments
   group                pends;
 
   string               write_plan;
+  string               table_cache;
+
+  init_val<int,1>      threads;
 
   arguments( int argc, char const* argv[] );
 
@@ -304,6 +310,17 @@ void arguments::bind( arg_parser& p )
          ( 'O', "output-plans",
            "Write plans out to directory or file (with % for the plan number)",
            "FILE", write_plan ) );
+
+  p.add( new string_opt
+         ( '\0', "table-cache",
+           "Read the multiplication table from FILE, or save it there "
+           "if it is not in FILE", "FILE", 
+           table_cache ) );
+
+  p.add( new integer_opt
+         ( '\0', "threads",
+           "Search using NUM threads (0 = one per processor)", "NUM",
+           threads ) );
 }
 
 bool arguments::validate( arg_parser& ap )
@@ -321,6 +338,14 @@ bool arguments::validate( arg_parser& ap )
       return false;
     }
 
+  if ( threads < 0 )
+    {
+      ap.error( "The number of threads must not be negative" );
+      return false;
+    }
+  if ( threads == 0 ) 
+    threads = hardware_concurrency();
+
   if ( !generate_pends( ap ) )
     return false;
 
@@ -361,53 +386,111 @@ class searcher {
 public:
   searcher( arguments const& args );
 
-  void recurse();
+  void search();
 
 private:
   typedef sqmulttab::row_t row_t;
 
   typedef method_list::const_iterator method_ptr;
-  typedef pair<method_ptr, method_ptr> method_pair;
   typedef vector<row_t> falseness_tab;
-  //typedef map<row_t, method_ptr, row_t::cmp> composition;
-  typedef multimap<row_t, method_ptr, row_t::cmp> pos_map;
+
+  // The possible methods at each lead head are kept as a bitset with
+  // one bit per method, and the lead heads not yet rung as a bitset
+  // with one bit per row of the table.  Where possible methods are 
+  // eliminated, the old value of the word is saved so it can be restored
+  // when backtracking.
+  typedef unsigned long word_t;
+  enum { word_bits = sizeof(word_t) * CHAR_BIT };
+  typedef vector< pair<size_t, word_t> > undo_list;
+
+  // A plan that has been found, as it is to be output.
+  struct found_plan {
+    string summary;
+    string plan;
+  };
+
+  // The state of one thread of the search.
+  struct state {
+    state( sqmulttab const& mt ) 
+      : comp(mt), free_count(0u), node_count(0u), buffered(false) {}
+
+    spliced_plan comp;
+
+    // Bit m of the words from lh * stride is set if method m is possible
+    // at lead head lh.
+    vector<word_t> possibles;
+
+    vector<word_t> free_lhs;
+    size_t free_count;
+
+    RINGING_ULLONG node_count;
+
+    // If set, plans are kept in PLANS rather than output as they're found
+    bool buffered;
+    vector<found_plan> plans;
+  };
+
+  class branch_searcher;
 
   sqmulttab* make_multtab();
   void init_pends();
   void init_falseness();
   void init_search();
-  void select_possibles( row_t& lh, vector<method_ptr>& meths ) const;
-  bool is_possible( row_t const& lh, method_ptr const& m ) const;
-  void found( unsigned rotn_count );
-  void set_method( row_t const& lh, method_ptr const& m );
-  void unset_method( row_t const& lh, method_ptr const& m );
-  void recheck_pos_map( row_t const& lh, method_ptr const& m,
-                        vector<pair<row_t, method_ptr> >& backtrack );
-  bool are_false( row_t const& lh1, method_ptr const& m1, 
-                  row_t const& lh2, method_ptr const& m2 ) const;
-  void done_with_method( method_ptr const& m );
-  bool is_rotational_standard_form( unsigned& rotn_count ) const;
+  void init_state( state& s ) const;
+  void recurse( state& s );
+  void try_method( state& s, row_t const& lh, method_ptr const& m, 
+                   int depth );
+  void search_branches( state& s );
+  void select_possibles( state const& s, row_t& lh, 
+                         vector<method_ptr>& meths ) const;
+  void found( state& s, unsigned rotn_count );
+  void output( found_plan const& p );
+  void set_method( state& s, row_t const& lh, method_ptr const& m ) const;
+  void unset_method( state& s, row_t const& lh, method_ptr const& m ) const;
+  void recheck_pos_map( state& s, row_t const& lh, method_ptr const& m, 
+                        undo_list& backtrack ) const;
+  void erase_possible( state& s, row_t const& lh, size_t m, 
+                       undo_list& backtrack ) const;
+  void erase_possibles( state& s, row_t const& lh, 
+                        undo_list& backtrack ) const;
+  void restore_possibles( state& s, undo_list const& backtrack ) const;
+  unsigned count_possibles( state const& s, size_t lh ) const;
+  void take_lead_head( state& s, row_t const& lh ) const;
+  void free_lead_head( state& s, row_t const& lh ) const;
+  void done_with_method( state& s, method_ptr const& m ) const;
+  bool is_rotational_standard_form( state const& s, 
+                                    unsigned& rotn_count ) const;
 
   arguments const& args;
 
-  RINGING_ULLONG node_count;
-
   scoped_pointer<sqmulttab> mt;
 
   method_list meths; 
-  map<method_pair, falseness_tab> false_data;
+  size_t meth_count;
   vector<row_t> pends;
 
-  set<row_t, row_t::cmp> free_lhs;
+  // For each pair of methods, the inverses of the elements of their
+  // falseness table, indexed by m2 * meth_count + m1.
+  vector<falseness_tab> false_data;
+
+  // The inverse of each method's lead head, and the rows of the table
+  // by their index.
+  vector<row_t> le_invs;
+  vector<row_t> lead_heads;
+
+  size_t stride;
+
+  int plan_n;
 
-  spliced_plan comp;
-  pos_map possibles;
+  // Serialises output from the different threads
+  mutex output_lock;
 };
 
 searcher::searcher( arguments const& args )
-  : args(args),
-    node_count(0), mt(make_multtab()), 
-    meths(litelib(args.bells, cin), *mt), comp(*mt)
+  : args(args), mt(make_multtab()), 
+    meths(litelib(args.bells, cin), *mt), 
+    meth_count( meths.end() - meths.begin() ), 
+    stride( ( meth_count + word_bits - 1 ) / word_bits ), plan_n(0)
 {
   init_pends();
   init_falseness();
@@ -418,10 +501,10 @@ sqmulttab* searcher::make_multtab()
 {
   if (args.in_course)
     return new sqmulttab( incourse_extent_iterator(args.bells-1, 1), 
-                          incourse_extent_iterator() );
+                          incourse_extent_iterator(), args.table_cache );
   else
     return new sqmulttab( extent_iterator(args.bells-1, 1), 
-                          extent_iterator() );
+                          extent_iterator(), args.table_cache );
 }
 
 void searcher::init_pends()
@@ -435,213 +518,243 @@ void searcher::init_pends()
 void searcher::init_falseness()  
 {
   int ftflags = 0 | (args.in_course ? falseness_table::in_course_only : 0);
-  for ( method_ptr i=meths.begin(), e=meths.end(); i != e; ++i )
-  for ( method_ptr j=meths.begin()               ; j != e; ++j ) {
-    falseness_table ft(i->meth, j->meth, ftflags);
-    vector<row_t> ft2;
-    for ( falseness_table::const_iterator fi=ft.begin(), fe=ft.end();
-          fi != fe; ++fi )
-      ft2.push_back( mt->find(*fi) );
-    false_data[ make_pair(i,j) ] = ft2;
-  }
-}
-
-bool searcher::is_possible( row_t const& lh, 
-                            searcher::method_ptr const& m ) const
-{
-  row_t le = lh * m->le;
-
-  // Is the le you would get by ringing a lead of the method free?
-  if ( le != lh && free_lhs.find(le) == free_lhs.end() )
-    return false;
-
-  // Is the lead true agaisnt all the methods currently chosen?
-  for ( spliced_plan::const_iterator ci = comp.begin(), ce = comp.end(); 
-        ci != ce; ++ci ) 
-  {
-    if ( are_false( lh, m, ci->first, ci->second ) )
-      return false;
+  false_data.resize( meth_count * meth_count );
+  for ( method_ptr i=meths.begin(), e=meths.end(); i != e; ++i ) {
+    le_invs.push_back( mt->find( mt->find(i->le).inverse() ) );
+
+    for ( method_ptr j=meths.begin()               ; j != e; ++j ) {
+      falseness_table ft(i->meth, j->meth, ftflags);
+      falseness_tab& ft2 = false_data[ (i - meths.begin()) * meth_count 
+                                       + (j - meths.begin()) ];
+      for ( falseness_table::const_iterator fi=ft.begin(), fe=ft.end();
+            fi != fe; ++fi )
+        ft2.push_back( mt->find( fi->inverse() ) );
+    }
   }
-
-  return true; 
 }
 
 void searcher::init_search()
 {
+  lead_heads.resize( mt->size() );
   if (args.in_course)
-    for ( incourse_extent_iterator i(args.bells-1, 1), e; i != e; ++i )
-      free_lhs.insert( mt->find(*i) );
+    for ( incourse_extent_iterator i(args.bells-1, 1), e; i != e; ++i ) {
+      row_t const lh( mt->find(*i) );
+      lead_heads[ lh.index() ] = lh;
+    }
   else
-    for ( extent_iterator i(args.bells-1, 1), e; i != e; ++i )
-      free_lhs.insert( mt->find(*i) );
-
-  DEBUG( "Have " << free_lhs.size() << " lead heads and ends" );
+    for ( extent_iterator i(args.bells-1, 1), e; i != e; ++i ) {
+      row_t const lh( mt->find(*i) );
+      lead_heads[ lh.index() ] = lh;
+    }
 
-  for ( set<row_t>::const_iterator 
-          li = free_lhs.begin(), le = free_lhs.end(); li != le; ++li ) 
-    for ( method_ptr mi=meths.begin(), me=meths.end(); mi != me; ++mi ) 
-      if ( is_possible( *li, mi ) )
-        possibles.insert( make_pair( *li, mi ) );
+  DEBUG( "Have " << lead_heads.size() << " lead heads and ends" );
 }
 
-bool searcher::are_false( row_t const& lh1, method_ptr const& m1, 
-                          row_t const& lh2, method_ptr const& m2 ) const
+void searcher::init_state( state& s ) const
 {
-  map<method_pair, falseness_tab>::const_iterator
-    fd = false_data.find( make_pair( m2, m1 ) );
-  assert( fd != false_data.end() );
+  s.free_count = lead_heads.size();
+  s.free_lhs.assign( ( s.free_count + word_bits - 1 ) / word_bits, 0ul );
+  for ( size_t i = 0; i < s.free_count; ++i )
+    s.free_lhs[ i / word_bits ] |= word_t(1) << i % word_bits;
+
+  // With nothing yet chosen, every method is possible at every lead head
+  s.possibles.assign( lead_heads.size() * stride, 0ul );
+  for ( size_t i = 0; i < lead_heads.size(); ++i ) 
+    for ( size_t m = 0; m < meth_count; ++m ) 
+      s.possibles[ i * stride + m / word_bits ] |= word_t(1) << m % word_bits;
+}
 
-  // We want to check each part against each other part, i.e.
-  //   ( p2 * lh2 * f == p1 * lh1 )
-  // for each p1, p2 in the part end group.  However, we can pre-multiply
-  // both sides by p2.inverse() as the part ends form a group (which is 
-  // therefore closed under multiplication and inverse), we can just 
-  // iterate once over the group.
- 
-  for ( falseness_tab::const_iterator 
-          fi=fd->second.begin(), fe=fd->second.end(); fi!=fe; ++fi ) {
-    row_t f = *fi;
-    for ( vector<row_t>::const_iterator
-            pi=pends.begin(), pe=pends.end(); pi!=pe; ++pi )
-      if ( lh2 * f == *pi * lh1 )
-        return true;
+void searcher::erase_possible( state& s, row_t const& lh, size_t m, 
+                               undo_list& backtrack ) const
+{
+  size_t const w = lh.index() * stride + m / word_bits;
+  word_t const bit = word_t(1) << m % word_bits;
+  if ( s.possibles[w] & bit ) {
+    backtrack.push_back( make_pair( w, s.possibles[w] ) );
+    s.possibles[w] &= ~bit;
   }
+}
+
+void searcher::erase_possibles( state& s, row_t const& lh, 
+                                undo_list& backtrack ) const
+{
+  for ( size_t w = lh.index() * stride, e = w + stride; w != e; ++w ) 
+    if ( s.possibles[w] ) {
+      backtrack.push_back( make_pair( w, s.possibles[w] ) );
+      s.possibles[w] = 0ul;
+    }
+}
 
-  return false;
+void searcher::restore_possibles( state& s, 
+                                  undo_list const& backtrack ) const
+{
+  for ( undo_list::const_reverse_iterator 
+          i = backtrack.rbegin(), e = backtrack.rend(); i != e; ++i )
+    s.possibles[ i->first ] = i->second;
 }
 
-void searcher::recheck_pos_map( row_t const& lh, method_ptr const& m,
-                                vector<pair<row_t,method_ptr> >& backtrack )
+unsigned searcher::count_possibles( state const& s, size_t lh ) const
+{
+  unsigned n = 0;
+  for ( size_t w = lh * stride, e = w + stride; w != e; ++w )
+    for ( word_t x = s.possibles[w]; x; x &= x - 1 )
+      ++n;
+  return n;
+}
+
+void searcher::recheck_pos_map( state& s, row_t const& lh, 
+                                method_ptr const& m, 
+                                undo_list& backtrack ) const
 {
   row_t const le = lh * m->le;
+  size_t const m1 = m - meths.begin();
 
-  for ( pos_map::iterator j=possibles.begin(), e=possibles.end(); j != e; ) 
+  for ( size_t m2 = 0; m2 < meth_count; ++m2 ) 
   {
-    pos_map::iterator i = j++;  // This allows us to erase i
-
-    if ( i->first * i->second->le == le ) {
-      backtrack.push_back(*i);
-      possibles.erase(i);
-      continue;
-    }
-  
-    if ( are_false( lh, m, i->first, i->second ) ) { 
-      backtrack.push_back(*i);
-      possibles.erase(i);
-    }
+    // The lead of m2 that would end at the same lead end
+    erase_possible( s, le * le_invs[m2], m2, backtrack );
+
+    // The leads of m2 that are false against this one.  We want to 
+    // check each part against each other part, i.e.
+    //   ( p2 * lh2 * f == p1 * lh ) 
+    // for each p1, p2 in the part end group.  However, we can pre-multiply
+    // both sides by p2.inverse() as the part ends form a group (which is 
+    // therefore closed under multiplication and inverse), we can just 
+    // iterate once over the group.
+    falseness_tab const& ft = false_data[ m2 * meth_count + m1 ];
+    for ( falseness_tab::const_iterator fi=ft.begin(), fe=ft.end(); 
+          fi!=fe; ++fi )
+      for ( vector<row_t>::const_iterator
+              pi=pends.begin(), pe=pends.end(); pi!=pe; ++pi )
+        erase_possible( s, *pi * lh * *fi, m2, backtrack );
   }
 }
 
-bool searcher::is_rotational_standard_form( unsigned& rotn_count ) const
+bool searcher::is_rotational_standard_form( state const& s,
+                                            unsigned& rotn_count ) const
 {
   unsigned rotn_eq_count = 0u;
 
-  for ( spliced_plan::const_iterator ci = comp.begin(), ce = comp.end(); 
+  for ( spliced_plan::const_iterator ci = s.comp.begin(), ce = s.comp.end();
         ci != ce; ++ci ) {
     // XXX:  This assumes that the set of lhs and les form a group
     // really we want inverse( ci->first ), but that's tedious to evaluate. 
     // If we start looking at touches with singles, this will need changing.
-    spliced_plan rotn( comp.make_rotation( ci->first ) );
-    if ( rotn <  comp ) return false;
-    if ( rotn == comp ) ++rotn_eq_count;
+    spliced_plan rotn( s.comp.make_rotation( ci->first ) );
+    if ( rotn <  s.comp ) return false;
+    if ( rotn == s.comp ) ++rotn_eq_count;
   }
 
-  assert( comp.size() % rotn_eq_count == 0 );
-  rotn_count = comp.size() / rotn_eq_count;
+  assert( s.comp.size() % rotn_eq_count == 0 );
+  rotn_count = s.comp.size() / rotn_eq_count;
 
   return true;
 }
 
-void searcher::done_with_method( method_ptr const& m ) 
+void searcher::done_with_method( state& s, method_ptr const& m ) const
 {
-  pos_map::iterator i = possibles.begin(), e = possibles.end();
-  while ( i != e ) {
-    pos_map::iterator j = i;  ++i;  // We can now call erase(j) safely
-    if ( j->second == m ) possibles.erase(j);
-  }
+  size_t const mi = m - meths.begin();
+  word_t const mask = ~( word_t(1) << mi % word_bits );
+  for ( size_t w = mi / word_bits; w < s.possibles.size(); w += stride )
+    s.possibles[w] &= mask;
 }
 
-void searcher::select_possibles( searcher::row_t& lh,
+void searcher::select_possibles( state const& s, searcher::row_t& lh,
                                  vector<method_ptr>& try_meths ) const
 {
   // First, lets choose which lead head to look at.  Our strategy is to
   // choose the l.h. with the fewest possible methods available.
-  pos_map::const_iterator i = possibles.begin(), e = possibles.end();
-
-  pair< pos_map::const_iterator, pos_map::const_iterator > best(i, i);
+  size_t best = lead_heads.size();
   unsigned best_sz = unsigned(-1);  
 
-  while ( i != e ) {
-    unsigned sz = 0;
-    pos_map::const_iterator j = i;
-    for ( ; j != e; ++j, ++sz )
-      if ( j->first != i->first )
-        break;
-    if ( sz < best_sz ) {
+  for ( size_t i = 0; i < lead_heads.size(); ++i ) {
+    unsigned sz = count_possibles(s, i);
+    if ( sz && sz < best_sz ) {
       best_sz = sz;
-      best = make_pair( i, j );
+      best = i;
     }
-    i = j;
   }
 
-  // BEST is the range in POSSIBLES where the l.h. has the fewest possible
-  // methods, and BEST_SZ is the number of methods.
-
-  if ( best.first == best.second ) {
-    try_meths.clear();
-  } 
-  else {
-    lh = best.first->first;
-    for ( ; best.first != best.second; ++best.first )
-      try_meths.push_back( best.first->second );
+  // BEST is the l.h. with the fewest possible methods, and BEST_SZ is 
+  // the number of methods.
+
+  try_meths.clear();
+  if ( best != lead_heads.size() ) {
+    lh = lead_heads[best];
+    for ( size_t w = 0; w < stride; ++w )
+      for ( word_t x = s.possibles[ best * stride + w ]; x; x &= x - 1 ) {
+        size_t b = 0;
+        while ( !( x & word_t(1) << b ) ) ++b;
+        try_meths.push_back( meths.begin() + w * word_bits + b );
+      }
   }
-  const int depth = comp.size() / 2;
 }
 
-void searcher::found( unsigned rotn_count )
+void searcher::found( state& s, unsigned rotn_count )
 {
-  static int plan_n = 0;
-  ++plan_n;
+  found_plan p;
 
   if ( args.write_plan.size() )
   {
-    string filename;
-    { size_t i = args.write_plan.find('%');
-      if ( i == string::npos ) 
-        filename = ( make_string() << args.write_plan 
-                                   << "/" << plan_n << ".plan" );
-      else
-        filename = ( make_string() << args.write_plan.substr(0,i)
-                                   << plan_n << args.write_plan.substr(i+1) );
-    }
-
-    ofstream os( filename.c_str() );
-    comp.write_plan(os);
-    os.close();
+    ostringstream os;
+    s.comp.write_plan(os);
+    p.plan = os.str();
   }
 
   map< method_ptr, unsigned > counts;
 
-  for ( spliced_plan::const_iterator ci = comp.begin(), ce = comp.end();
+  for ( spliced_plan::const_iterator ci = s.comp.begin(), ce = s.comp.end();
           ci != ce; ++ci ) {
     counts[ ci->second ]++;
   }
 
   if (!args.quiet) {
+    ostringstream os;
     bool comma = false;
     for ( map<method_ptr, unsigned >::iterator 
             i = counts.begin(), e = counts.end(); i !=e; ++i ) {
-      if (comma) cout << ", ";
-      cout << i->first->meth.name() << " (" << i->second << ")";
+      if (comma) os << ", ";
+      os << i->first->meth.name() << " (" << i->second << ")";
       comma = true;
     }
     if ( args.prune_rotations )
-      cout << " [" << rotn_count << " rotations]";
-    cout << endl;
+      os << " [" << rotn_count << " rotations]";
+    p.summary = os.str();
   }
+
+  if ( s.buffered )
+    s.plans.push_back(p);
+  else 
+    output(p);
 }
 
-void searcher::set_method( row_t const& lh1, method_ptr const& m )
+void searcher::output( found_plan const& p )
+{
+  ++plan_n;
+
+  if ( args.write_plan.size() )
+  {
+    string filename;
+    { size_t i = args.write_plan.find('%');
+      if ( i == string::npos ) 
+        filename = ( make_string() << args.write_plan 
+                                   << "/" << plan_n << ".plan" );
+      else
+        filename = ( make_string() << args.write_plan.substr(0,i)
+                                   << plan_n << args.write_plan.substr(i+1) );
+    }
+
+    ofstream os( filename.c_str() );
+    os << p.plan;
+    os.close();
+  }
+
+  if (!args.quiet)
+    cout << p.summary << endl;
+}
+
+void searcher::set_method( state& s, row_t const& lh1, 
+                           method_ptr const& m ) const
 {
   bool palindrome = false;
   row_t const le1 = lh1 * m->le;
@@ -658,19 +771,20 @@ void searcher::set_method( row_t const& lh1, method_ptr const& m )
   {
     row_t const lh = *pi * lh1;
     DEBUG( "Setting " << m->meth.name() << " at " << mt->find(lh) );
-    comp.set_method( lh, m );
-    assert_erase( free_lhs, lh );
+    s.comp.set_method( lh, m );
+    take_lead_head( s, lh );
   
     if ( !palindrome ) {
       row_t const le = *pi * le1;
       DEBUG( " ... and " << m->meth.name() << " at " << mt->find(le) );
-      comp.set_method( le, m );
-      assert_erase( free_lhs, le );
+      s.comp.set_method( le, m );
+      take_lead_head( s, le );
     }
   }
 }
 
-void searcher::unset_method( row_t const& lh1, method_ptr const& m )
+void searcher::unset_method( state& s, row_t const& lh1, 
+                             method_ptr const& m ) const
 {
   bool palindrome = false;
   row_t const le1 = lh1 * m->le;
@@ -687,63 +801,201 @@ void searcher::unset_method( row_t const& lh1, method_ptr const& m )
   {
     row_t const lh = *pi * lh1;
     DEBUG( "Unsetting " << m->meth.name() << " at " << mt->find(lh) );
-    free_lhs.insert(lh);
-    comp.unset_method( lh );
+    free_lead_head( s, lh );
+    s.comp.unset_method( lh );
   
     if ( !palindrome ) {
       row_t const le = *pi * le1;
       DEBUG( " ... and " << m->meth.name() << " at " << mt->find(le) );
-      free_lhs.insert(le);
-      comp.unset_method( le );
+      free_lead_head( s, le );
+      s.comp.unset_method( le );
     }
   }
 }
 
-void searcher::recurse()
+
+void searcher::take_lead_head( state& s, row_t const& lh ) const
+{
+  word_t& w = s.free_lhs[ lh.index() / word_bits ];
+  word_t const bit = word_t(1) << lh.index() % word_bits;
+  assert( w & bit );
+  w &= ~bit;  --s.free_count;
+}
+
+void searcher::free_lead_head( state& s, row_t const& lh ) const
+{
+  word_t& w = s.free_lhs[ lh.index() / word_bits ];
+  word_t const bit = word_t(1) << lh.index() % word_bits;
+  assert( !( w & bit ) );
+  w |= bit;  ++s.free_count;
+}
+
+void searcher::search()
+{
+  state s( *mt );
+  init_state(s);
+
+  if ( args.threads == 1 ) 
+    recurse(s);
+  else
+    search_branches(s);
+
+  if (args.verbosity) 
+    cerr << "Searched " << s.node_count << " nodes\n";
+}
+
+void searcher::recurse( state& s )
 {
   row_t lh;
   vector<method_ptr> try_meths;
-  select_possibles( lh, try_meths );
+  select_possibles( s, lh, try_meths );
 
-  possibles.erase(lh);
+  undo_list taken;
+  if ( try_meths.size() )
+    erase_possibles( s, lh, taken );
 
-  const int depth = comp.size() / 2;
+  const int depth = s.comp.size() / 2;
 
   for ( vector<method_ptr>::const_iterator 
           i = try_meths.begin(), e = try_meths.end(); i != e; ++i )
   {
-    if (args.verbosity && depth == 0)
-      cerr << "Trying start method: " << (*i)->meth.name() << endl;
-
-    if (depth && depth < args.verbosity)
-      cerr << string(depth, ' ') << string(depth, ' ') << mt->find(lh) 
-           << " -> " << (*i)->meth.name() << endl;
-
-    vector<pair<row_t, method_ptr> > undo;
-    set_method(lh, *i);
-    recheck_pos_map(lh, *i, undo);
-    if ( free_lhs.empty() ) {
-      unsigned rotn_count = 0;
-      bool canonical_rotn = is_rotational_standard_form(rotn_count);
-      if ( !args.prune_rotations || canonical_rotn ) 
-        found( rotn_count );  
-    }
-    else recurse();
-    unset_method(lh, *i);
-    copy( undo.begin(), undo.end(), inserter(possibles, possibles.begin()) );
+    try_method( s, lh, *i, depth );
 
     // Poor man's rotational pruning
     if (depth == 0 && args.prune_rotations) 
-      done_with_method(*i);
+      done_with_method( s, *i );
   }
 
-  for ( vector<method_ptr>::const_iterator 
-          i = try_meths.begin(), e = try_meths.end(); i != e; ++i )
-    possibles.insert( make_pair(lh, *i) );
+  restore_possibles( s, taken );
+
+  ++s.node_count;
+}
+
+void searcher::try_method( state& s, row_t const& lh, method_ptr const& m,
+                           int depth )
+{
+  if (args.verbosity && depth == 0) {
+    mutex::scoped_lock l( output_lock );
+    cerr << "Trying start method: " << m->meth.name() << endl;
+  }
+
+  if (depth && depth < args.verbosity) {
+    mutex::scoped_lock l( output_lock );
+    cerr << string(depth, ' ') << string(depth, ' ') << mt->find(lh) 
+         << " -> " << m->meth.name() << endl;
+  }
+
+  undo_list undo;
+  set_method( s, lh, m );
+  recheck_pos_map( s, lh, m, undo );
+  if ( s.free_count == 0 ) {
+    // Comparing every rotation of the plan is much slower than the
+    // search, so only do it if the rotations are wanted
+    unsigned rotn_count = 0;
+    if ( !args.prune_rotations || is_rotational_standard_form(s, rotn_count) )
+      found( s, rotn_count );  
+  }
+  else recurse(s);
+  unset_method( s, lh, m );
+  restore_possibles( s, undo );
+}
+
+// Searches the subtrees for each of the methods tried at the first
+// lead head in parallel.  Each subtree is searched from a copy of the
+// state the serial search would have at that point, and the plans
+// found in it are output once those in the earlier subtrees have been,
+// so the output is the same as the serial search's.
+class searcher::branch_searcher : public thread_task
+{
+public:
+  branch_searcher( searcher& s, state const& root, row_t const& lh,
+                   vector<method_ptr> const& try_meths, 
+                   vector< vector<found_plan> >& plans, 
+                   vector<bool>& done, size_t& next, size_t& next_output,
+                   RINGING_ULLONG& node_count, mutex& lock )
+    : s(s), root(root), lh(lh), try_meths(try_meths), plans(plans), 
+      done(done), next(next), next_output(next_output), 
+      node_count(node_count), lock(lock) 
+  {}
+
+private:
+  virtual void run() {
+    while (true) {
+      size_t i;
+      {
+        mutex::scoped_lock l( lock );
+        if ( next == try_meths.size() ) return;
+        i = next++;
+      }
+
+      state st( root );
+      st.buffered = true;
+
+      // The serial search has already tried the earlier methods here
+      if ( s.args.prune_rotations ) 
+        for ( size_t j = 0; j < i; ++j ) 
+          s.done_with_method( st, try_meths[j] );
+
+      s.try_method( st, lh, try_meths[i], 0 );
+
+      mutex::scoped_lock l( lock );
+      plans[i].swap( st.plans );
+      done[i] = true;
+      node_count += st.node_count;
+
+      for ( ; next_output < try_meths.size() && done[next_output]; 
+            ++next_output ) {
+        vector<found_plan>& p = plans[next_output];
+        for ( vector<found_plan>::const_iterator j=p.begin(), e=p.end(); 
+              j != e; ++j )
+          s.output(*j);
+        vector<found_plan>().swap(p);
+      }
+    }
+  }
+
+  searcher& s;
+  state const& root;
+  row_t const& lh;
+  vector<method_ptr> const& try_meths;
+  vector< vector<found_plan> >& plans;
+  vector<bool>& done;
+  size_t& next;
+  size_t& next_output;
+  RINGING_ULLONG& node_count;
+  mutex& lock;
+};
+
+void searcher::search_branches( state& s )
+{
+  row_t lh;
+  vector<method_ptr> try_meths;
+  select_possibles( s, lh, try_meths );
+
+  undo_list taken;
+  if ( try_meths.size() )
+    erase_possibles( s, lh, taken );
+
+  vector< vector<found_plan> > plans( try_meths.size() );
+  vector<bool> done( try_meths.size() );
+  size_t next = 0, next_output = 0;
+  RINGING_ULLONG node_count = 0u;
+  {
+    mutex lock;
+    vector< shared_pointer<branch_searcher> > searchers;
+    vector<thread_task*> tasks;
+    for ( int i = 0; i < args.threads; ++i ) {
+      searchers.push_back( shared_pointer<branch_searcher>
+        ( new branch_searcher( *this, s, lh, try_meths, plans, done, 
+                               next, next_output, node_count, lock ) ) );
+      tasks.push_back( searchers.back().get() );
+    }
+    run_threads( tasks );
+  }
+
+  restore_possibles( s, taken );
 
-  ++node_count;
-  if (depth == 0 && args.verbosity) 
-    cerr << "Searched " << node_count << " nodes\n";
+  s.node_count += node_count + 1;
 }
 
 class analyser
@@ -859,10 +1111,10 @@ sqmulttab* analyser::make_multtab()
 {
   if (args.in_course)
     return new sqmulttab( incourse_extent_iterator(args.bells-1, 1), 
-                          incourse_extent_iterator() );
+                          incourse_extent_iterator(), args.table_cache );
   else
     return new sqmulttab( extent_iterator(args.bells-1, 1), 
-                          extent_iterator() );
+                          extent_iterator(), args.table_cache );
 }
 
 int main(int argc, char const* argv[] )
@@ -875,7 +1127,7 @@ int main(int argc, char const* argv[] )
   const bool search = true;
 
   if (search)
-    searcher(args).recurse();
+    searcher(args).search();
   else {
     analyser a(args);
     for ( int i=1; i<argc; ++i )
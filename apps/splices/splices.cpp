@@ -25,8 +25,11 @@
 #include <ringing/litelib.h>
 #include <ringing/group.h>
 #include <ringing/falseness.h>
+#include <ringing/thread.h>
+#include <ringing/pointers.h>
 #include "args.h"
 
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <set>
@@ -56,6 +59,9 @@ struct arguments
   init_val<bool,false> filter_mode;
   init_val<bool,false> read_rows;
 
+  init_val<int,1>      threads;
+  init_val<bool,false> stats;
+
   vector<string>       meth_str;
   vector<method>       meth;
 
@@ -162,6 +168,17 @@ void arguments::bind( arg_parser& p )
          ( '\0', "read-rows",
            "Read the rows of a method from standard input",
            read_rows ) );
+
+  p.add( new integer_opt
+         ( '\0', "threads",
+           "Compare methods using NUM threads (0 = one per processor)", 
+           "NUM",
+           threads ) );
+
+  p.add( new boolean_opt
+         ( '\0', "stats",
+           "Print how many pairs of methods were ruled out early",
+           stats ) );
 }
 
 bool arguments::validate( arg_parser& ap )
@@ -179,6 +196,14 @@ bool arguments::validate( arg_parser& ap )
       return false;
     }
 
+  if ( threads < 0 )
+    {
+      ap.error( "The number of threads must not be negative" );
+      return false;
+    }
+  if ( threads == 0 ) 
+    threads = hardware_concurrency();
+
   if ( (in_course || read_rows) && out_of_course )
     { 
       ap.error( "The -o option cannot be used with either -i or --read-rows" );
@@ -254,7 +279,8 @@ bool arguments::validate( arg_parser& ap )
 
 class splices {
 public:
-  splices( arguments const& args ) : args(args) {}
+  splices( arguments const& args ) 
+    : args(args), pairs_pruned(0), pairs_tested(0) {}
 
   void find_splices( library const& lib );
 
@@ -262,9 +288,26 @@ private:
   static string name_or_pn( arguments const& args, method const& m );
   class sort_function;
 
-  bool test_splice( method const& a, method const& b );
-  string test_splice( method const& a, vector<row> const& b, 
+  // A method together with the rows of its lead, which are calculated
+  // once when it is read rather than for every pair it is tested in.
+  struct lead {
+    lead( method const& m, vector<row> const& rows ) : m(m), rows(rows) {}
+    bool operator<( lead const& o ) const { return m < o.m; }
+    method m;
+    vector<row> rows;
+  };
+  class pair_tester;
+
+  vector<row> lead_rows( method const& m ) const;
+  string find_splice( vector<row> const& a, vector<row> const& b ) const;
+  bool wanted_group( size_t size, size_t max_size ) const;
+  void count_pair( bool pruned ) const;
+  string test_splice( lead const& a, vector<row> const& b, 
                       string const& b_name = string() );
+  bool test_splice( lead const& a, lead const& b );
+  void test_splices( lead const& a, vector<lead const*> const& bs );
+  void report_splice( method const& a, string const& b_name, 
+                      string const& desc ) const;
   bell get_pivot( group const& sg ) const;
   pair<bell, bell> get_swapping_pair( group const& sg ) const;
   string describe_splice( group const& sg ) const;
@@ -279,6 +322,9 @@ private:
   typedef list< pair< string, set<method> > > table_type;
   table_type table;
   arguments const& args;
+
+  mutable mutex stats_lock;
+  mutable size_t pairs_pruned, pairs_tested;
 };
 
 string splices::name_or_pn( arguments const& args, method const& m )
@@ -502,8 +548,19 @@ string splices::describe_splice( group const& sg ) const
   return os;
 }
 
-string splices::test_splice( method const& a, vector<row> const& b,
-                             string const& b_name )
+vector<row> splices::lead_rows( method const& m ) const
+{
+  int flags = row_block::no_final_lead_head; 
+  if ( args.half_leads ) 
+    flags |= row_block::half_lead_only;
+
+  return row_block( m, row(args.bells), flags );
+}
+
+// Returns the description of the splice between the leads a and b, or
+// an empty string if it is not to be shown.  Unless -F or -G is given,
+// this does no output and so can be called from several threads.
+string splices::find_splice( vector<row> const& a, vector<row> const& b ) const
 { 
   size_t max_size = factorial(args.bells-1);
 
@@ -525,53 +582,153 @@ string splices::test_splice( method const& a, vector<row> const& b,
     return string();
   }
 
+  // Most pairs have no splice and generate the whole group.  Listing
+  // the elements of such a group is by far the slowest part of testing 
+  // a pair, so check its order first and only list the elements of 
+  // groups that are wanted.
+  if ( !args.print_group && !wanted_group( ft.group_order(), max_size ) ) {
+    count_pair( true );
+    return string();
+  }
+
+  count_pair( false );
   group sg( ft.generate_group() );
   if ( args.print_group ) {
     copy( sg.begin(), sg.end(), ostream_iterator<row>(cout, "\n") );
     return string();
   }
 
-  if ( !args.null_splices && sg.size() == max_size )
+  if ( !wanted_group( sg.size(), max_size ) )
     return string();
 
-  if ( args.only_n_leads != -1 && sg.size() != args.only_n_leads * 2 &&
-       // Need to store lead splices if we're to group them
-       ( !args.group_splices && !args.filter_mode || sg.size() != 2 ) )
-    return string();
+  return describe_splice(sg);
+}
 
-  if ( args.only_n_leads != -1 && sg.size() != args.only_n_leads * 2 )
-    return string();
+bool splices::wanted_group( size_t size, size_t max_size ) const
+{
+  if ( !args.null_splices && size == max_size )
+    return false;
 
-  string desc( describe_splice(sg) );
+  if ( args.only_n_leads != -1 && size != args.only_n_leads * 2 )
+    return false;
+
+  return true;
+}
+
+void splices::count_pair( bool pruned ) const
+{
+  if ( args.stats ) {
+    mutex::scoped_lock l( stats_lock );
+    ++( pruned ? pairs_pruned : pairs_tested );
+  }
+}
+
+void splices::report_splice( method const& a, string const& b_name,
+                             string const& desc ) const
+{
   if ( !args.group_splices && !args.filter_mode ) {
     cout << name_or_pn(args, a);
     if ( args.meth.size() != 1 ) 
       cout << " / " << b_name;
     cout << "\t" << desc << "\n";
   }
+}
+
+string splices::test_splice( lead const& a, vector<row> const& b,
+                             string const& b_name )
+{ 
+  string desc( find_splice( a.rows, b ) );
+  if ( desc.size() )
+    report_splice( a.m, b_name, desc );
   return desc;
 }
 
-bool splices::test_splice( method const& a, method const& b )
+bool splices::test_splice( lead const& a, lead const& b )
 {
   // If we're grouping splices, this gets done later.  This is so that
   // we can output, e.g.  Bv,Su / Bk,He  for surprise minor lead splices.
-  if ( !args.group_splices && args.same_le && a.back() != b.back() )
+  if ( !args.group_splices && args.same_le && a.m.back() != b.m.back() )
     return false;
 
-  int flags = row_block::no_final_lead_head; 
-  if ( args.half_leads ) 
-    flags |= row_block::half_lead_only;
-
-  row lh(args.bells);
-  string desc = test_splice( a, row_block(b, lh, flags), name_or_pn(args, b) );
+  string desc = test_splice( a, b.rows, name_or_pn(args, b.m) );
 
   if ( desc.size() && ( args.group_splices || args.filter_mode ) )
-    save_splice( a, b, desc );
+    save_splice( a.m, b.m, desc );
 
   return desc.size();
 }
 
+// Tests a for splices with each of bs in turn, sharing the work 
+// between threads.  The splices are found in parallel, but are reported 
+// and saved afterwards in the same order as testing them one at a time.
+class splices::pair_tester : public thread_task
+{
+public:
+  pair_tester( splices const& s, lead const& a, 
+               vector<lead const*> const& bs,
+               vector<string>& descs, size_t& next, mutex& lock )
+    : s(s), a(a), bs(bs), descs(descs), next(next), lock(lock) {}
+
+private:
+  virtual void run() {
+    // Take the pairs in small batches to keep contention on the lock low
+    size_t const batch = 16;
+    while (true) {
+      size_t i, e;
+      {
+        mutex::scoped_lock l( lock );
+        if ( next == bs.size() ) return;
+        i = next;  e = next = min( next + batch, bs.size() );
+      }
+
+      for ( ; i != e; ++i )
+        if ( s.args.group_splices || !s.args.same_le 
+             || a.m.back() == bs[i]->m.back() )
+          descs[i] = s.find_splice( a.rows, bs[i]->rows );
+    }
+  }
+
+  splices const& s;
+  lead const& a;
+  vector<lead const*> const& bs;
+  vector<string>& descs;
+  size_t& next;
+  mutex& lock;
+};
+
+void splices::test_splices( lead const& a, vector<lead const*> const& bs )
+{
+  // Starting threads costs more than testing a few pairs, and -F and -G
+  // print straight to cout
+  if ( args.threads == 1 || bs.size() < 64 
+       || args.print_falseness || args.print_group ) {
+    for ( vector<lead const*>::const_iterator i=bs.begin(), e=bs.end(); 
+          i!=e; ++i )
+      test_splice( a, **i );
+    return;
+  }
+
+  vector<string> descs( bs.size() );
+  {
+    size_t next = 0;  mutex lock;
+    vector< shared_pointer<pair_tester> > testers;
+    vector<thread_task*> tasks;
+    for ( int i = 0; i < args.threads; ++i ) {
+      testers.push_back( shared_pointer<pair_tester>
+        ( new pair_tester( *this, a, bs, descs, next, lock ) ) );
+      tasks.push_back( testers.back().get() );
+    }
+    run_threads( tasks );
+  }
+
+  for ( size_t i = 0; i < bs.size(); ++i )
+    if ( descs[i].size() ) {
+      report_splice( a.m, name_or_pn(args, bs[i]->m), descs[i] );
+      if ( args.group_splices || args.filter_mode )
+        save_splice( a.m, bs[i]->m, descs[i] );
+    }
+}
+
 method splices::get_method( library_entry const& e )
 {
   method m( e.meth() );
@@ -587,32 +744,38 @@ method splices::get_method( library_entry const& e )
 void splices::find_splices( library const& lib )
 {
   // The source library may not support restarting (e.g. if its 
-  // a litelib on stdin), so load them into a methodset as we 
-  // find them.
-  methodset meths;
-  meths.store_facet< litelib::payload >();
+  // a litelib on stdin), so keep the methods as we find them.  As with
+  // a methodset, duplicates are dropped and they are kept in order.
+  set<lead> meths;
+
+  scoped_pointer<lead> const given( args.meth.size() != 1 ? NULL 
+    : new lead( args.meth.front(), lead_rows( args.meth.front() ) ) );
 
   typedef library::const_iterator const_iterator;
   for ( const_iterator i=lib.begin(), e=lib.end(); i!=e; ++i ) 
   {
     method m( get_method(*i) );
+    lead const l( m, lead_rows(m) );
 
     bool filter_ok = false;
 
     if ( args.read_rows ) {
-      test_splice( m, args.rows );
+      test_splice( l, args.rows );
     }
 
-    else if ( args.meth.size() == 1 ) {
-      if ( m != args.meth.front() ) 
-        filter_ok = test_splice( m, args.meth.front() );
+    else if ( given ) {
+      if ( m != given->m ) 
+        filter_ok = test_splice( l, *given );
     }
 
     else {
-      for ( const_iterator j=meths.begin(), f=meths.end(); j!=f; ++j )
-        test_splice( m, get_method(*j) );
+      vector<lead const*> bs;  bs.reserve( meths.size() );
+      for ( set<lead>::const_iterator j=meths.begin(), f=meths.end(); 
+            j!=f; ++j )
+        bs.push_back( &*j );
+      test_splices( l, bs );
 
-      meths.push_back(*i);
+      meths.insert(l);
 
       filter_ok = !has_lead_splices(i->meth());
     }
@@ -624,6 +787,10 @@ void splices::find_splices( library const& lib )
 
   if ( args.group_splices ) 
     print_splice_groups();
+
+  if ( args.stats )
+    cerr << pairs_pruned << " pairs ruled out by group order, "
+         << pairs_tested << " pairs tested fully\n";
 }
 
 int main( int argc, char *argv[] )
@@ -190,11 +190,14 @@ void search( arguments const& args, method const& meth,
       (args.round_blocks ? 0 : table_search::non_round_blocks ) |
       (args.mutually_true_parts ? table_search::mutually_true_parts : 0) );
 
-    searcher.reset
-      ( new table_search( meth, args.calls, args.pends, args.length, f ) );
+    table_search* ts
+      = new table_search( meth, args.calls, args.pends, args.length, f );
+    searcher.reset( ts );
+    ts->set_table_cache( args.table_cache );
   }
 
-  touch_search_until( *searcher, iter_from_fun(printer), have_finished(args) );
+  touch_search_until( *searcher, iter_from_fun(printer), have_finished(args),
+                      args.threads );
 }
 
 void filter( arguments const& args )
@@ -32,6 +32,7 @@
 #include <ringing/method.h>
 #include <ringing/group.h>
 #include <ringing/streamutils.h>
+#include <ringing/thread.h>
 
 #include <string>
 #if RINGING_OLD_INCLUDES 
@@ -138,6 +139,18 @@ void arguments::bind( arg_parser& p )
            "Limit the search to the first NUM touches", "NUM",
            search_limit ) );
 
+  p.add( new integer_opt
+         ( '\0', "threads",
+           "Run the search using NUM threads (0 = one per processor)", 
+           "NUM",
+           threads ) );
+
+  p.add( new string_opt
+         ( '\0', "table-cache",
+           "Read the multiplication table from FILE, or save it there "
+           "if it is not in FILE", "FILE",
+           table_cache ) );
+
   p.add( new boolean_opt
          ( '\0', "filter",
            "Run as a filter on a method library",
@@ -189,6 +202,13 @@ bool arguments::validate( arg_parser& ap )
     }
   }
 
+  if ( threads < 0 ) {
+    ap.error( "The number of threads must not be negative" );
+    return false;
+  }
+  if ( threads == 0 ) 
+    threads = hardware_concurrency();
+
   if ( plain_name.empty() ) 
     plain_name = comma_separate ? 'p' : '.';
  
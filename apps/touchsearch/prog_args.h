@@ -58,8 +58,10 @@ struct arguments
   init_val<bool,false> comma_separate;
   init_val<bool,false> use_plan;
   init_val<bool,true>  round_blocks;
+  init_val<int,1>      threads;
 
   string               plain_name;
+  string               table_cache;
   string               meth_str;
   method               meth;
 
@@ -0,0 +1,130 @@
+// -*- C++ -*- benchrow.cpp - time the basic row operations
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/common.h>
+#if RINGING_OLD_INCLUDES
+#include <iostream.h>
+#include <iomanip.h>
+#include <vector.h>
+#else
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#endif
+#if RINGING_OLD_C_INCLUDES
+#include <time.h>
+#include <stdlib.h>
+#else
+#include <ctime>
+#include <cstdlib>
+#endif
+#include <ringing/row.h>
+#include <ringing/method.h>
+
+#if RINGING_USE_NAMESPACES
+using namespace ringing;
+#endif
+
+// Usage: benchrow [ITERATIONS]
+//
+// Reports the throughput of transposition, division, inversion and
+// change application on a selection of stages.  The checksum is
+// printed so that the compiler cannot discard the work, and so that
+// two builds can be checked for identical results.
+
+struct timer
+{
+  timer() : start( clock() ) {}
+  double elapsed() const { return double(clock() - start) / CLOCKS_PER_SEC; }
+  clock_t start;
+};
+
+void report( char const* what, int bells, unsigned long n, double t,
+             unsigned long sum )
+{
+  cout << setw(10) << what << setw(4) << bells << "  "
+       << setw(10) << fixed << setprecision(2)
+       << ( t > 0 ? n / t / 1e6 : 0.0 ) << " Mops/s"
+       << "  (checksum " << sum << ")" << endl;
+}
+
+void bench_stage( char const* pn, int bells, unsigned long iters )
+{
+  method m( pn, bells );
+  row const lh( m.lh() );
+  row const x( row::pblh(bells) );
+
+  {
+    row r( bells );  unsigned long sum = 0;  timer t;
+    for ( unsigned long i = 0; i < iters; ++i ) {
+      r = r * lh;  sum += r[1];
+    }
+    report( "multiply", bells, iters, t.elapsed(), sum );
+  }
+
+  {
+    row r( bells );  unsigned long sum = 0;  timer t;
+    for ( unsigned long i = 0; i < iters; ++i ) {
+      r = r / x;  sum += r[1];
+    }
+    report( "divide", bells, iters, t.elapsed(), sum );
+  }
+
+  {
+    row r( lh );  unsigned long sum = 0;  timer t;
+    for ( unsigned long i = 0; i < iters; ++i ) {
+      r = r.inverse() * x;  sum += r[1];
+    }
+    report( "inverse", bells, iters, t.elapsed(), sum );
+  }
+
+  {
+    row r( bells );  unsigned long sum = 0, n = 0;  timer t;
+    for ( unsigned long i = 0; i < iters; i += m.size() )
+      for ( method::const_iterator j=m.begin(), e=m.end(); j!=e; ++j ) {
+        r *= *j;  sum += r[1];  ++n;
+      }
+    report( "change", bells, n, t.elapsed(), sum );
+  }
+
+  {
+    unsigned long sum = 0, n = 0;  timer t;
+    for ( unsigned long i = 0; i < iters; i += m.size() ) {
+      row_block rb( m, x );
+      sum += rb.back()[1];  n += m.size();
+    }
+    report( "row_block", bells, n, t.elapsed(), sum );
+  }
+}
+
+int main( int argc, char** argv )
+{
+  unsigned long iters = argc > 1 ? atol( argv[1] ) : 5000000ul;
+
+  bench_stage( "&-36-14-12-36-14-56,12", 6, iters );
+  bench_stage( "&-38-14-1258-36-14-58-16-78,12", 8, iters );
+  bench_stage( "&-30-14-1250-36-1470-58-16-70-18-90,12", 10, iters );
+  bench_stage( "&-3T-14-125T-36-147T-58-169T-70-18-9T-10-ET,12", 12, iters );
+  bench_stage( "&-1D-1D-1D-1D-1D-1D-1D-1D,12", 16, iters );
+  bench_stage( "&-1J-1J-1J-1J-1J-1J-1J-1J-1J-1J,12", 20, iters );
+  bench_stage( "&-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y-1Y,12"
+               , 32, iters );
+
+  return 0;
+}
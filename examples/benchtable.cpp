@@ -0,0 +1,128 @@
+// -*- C++ -*- benchtable.cpp - time table_search on Major and Royal
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/common.h>
+#if RINGING_OLD_INCLUDES
+#include <iostream.h>
+#include <iomanip.h>
+#include <vector.h>
+#else
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#endif
+#if RINGING_OLD_C_INCLUDES
+#include <stdlib.h>
+#else
+#include <cstdlib>
+#endif
+#if RINGING_WINDOWS && !defined(__CYGWIN__)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#include <ringing/method.h>
+#include <ringing/table_search.h>
+#include <ringing/touch.h>
+
+#if RINGING_USE_NAMESPACES
+using namespace ringing;
+#endif
+
+// Usage: benchtable [THREADS]
+//
+// Reports the time taken by a selection of touch searches on eight
+// and ten bells.  The time includes building the multiplication table,
+// which is reported separately by running each search with a length
+// of zero.  The touch count is printed so that two builds can be
+// checked for identical results.
+
+// Measures wall-clock time: clock() would add together the time spent
+// in each thread of a threaded search.
+struct timer
+{
+  timer() : start( now() ) {}
+  double elapsed() const { return now() - start; }
+
+  static double now()
+  {
+#if RINGING_WINDOWS && !defined(__CYGWIN__)
+    return GetTickCount() / 1000.0;
+#else
+    timeval tv;  gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+  }
+
+  double start;
+};
+
+class counter : public search_base::outputer
+{
+public:
+  counter() : n(0ul) {}
+  virtual bool operator()( const touch & ) { ++n; return false; }
+  unsigned long n;
+};
+
+void bench( char const* name, char const* pn, int bells,
+            char const* bob, char const* single, size_t max_len,
+            unsigned threads )
+{
+  method m( pn, bells );
+  vector<change> calls;
+  calls.push_back( change( bells, bob ) );
+  if (single) calls.push_back( change( bells, single ) );
+
+  double setup;
+  {
+    table_search s( m, calls, group(), make_pair( size_t(0), size_t(0) ),
+                    table_search::length_in_changes );
+    counter c;  timer t;
+    s.run( c );
+    setup = t.elapsed();
+  }
+
+  table_search s( m, calls, group(), make_pair( size_t(0), max_len ),
+                  table_search::length_in_changes );
+  counter c;  timer t;
+  s.run( c, threads );
+  double const total = t.elapsed();
+
+  cout << setw(28) << left << name << right
+       << setw(6) << max_len << " changes  "
+       << fixed << setprecision(2)
+       << setw(8) << setup << "s setup "
+       << setw(8) << total - setup << "s search  "
+       << "(" << c.n << " touches)" << endl;
+}
+
+int main( int argc, char** argv )
+{
+  unsigned threads = argc > 1 ? atoi( argv[1] ) : 1;
+
+  bench( "Plain Bob Major", "&-1-1-1-1,2", 8, "14", "1234", 320, threads );
+  bench( "Cambridge Surprise Major", "&-3-4-25-36-4-5-6-7,2", 8,
+         "14", "1234", 576, threads );
+  bench( "Plain Bob Royal", "&-1-1-1-1-1,2", 10, "14", "1234", 360, threads );
+  bench( "Cambridge Surprise Royal", "&-3-4-25-36-47-58-6-7-8-9,2", 10,
+         "14", NULL, 1000, threads );
+
+  return 0;
+}
@@ -86,10 +86,17 @@
 // or to 0 otherwise
 #define RINGING_READLINE_NEEDS_STDIO_H 0
 
+// *** Define this to be 1 if want to use POSIX threads for multithreaded
+// searches or to 0 otherwise.
+#define RINGING_USE_THREADS 0
+
 // *** Define this to be 1 if you have std::hash
 #define RINGING_HAS_STD_HASH 0
 
 // *** Define this to be 1 if you have long long
 #define RINGING_HAVE_LONG_LONG 1
 
+// *** Define this to be 1 if you have the POSIX mmap function
+#define RINGING_HAVE_MMAP 0
+
 #endif // RINGING_COMMON_MSVC_H
@@ -30,6 +30,7 @@
 #include <ringing/streamutils.h>
 #include <ringing/pointers.h>
 #include <ringing/group.h>
+#include <ringing/thread.h>
 #if RINGING_OLD_INCLUDES
 #include <algo.h>
 #include <iterator.h>
@@ -62,6 +63,82 @@ static bool are_tenors_together( const row &r, int working_bells )
   return true;
 }
 
+RINGING_START_ANON_NAMESPACE
+
+// Sort the rows and remove duplicates.  This is much cheaper than 
+// inserting them one at a time into a set<row>.
+void sort_unique( vector<row>& v )
+{
+  sort( v.begin(), v.end() );
+  v.erase( unique( v.begin(), v.end() ), v.end() );
+}
+
+// Add a row to a buffer that is sorted and uniqued whenever it fills,
+// so that it stays within a small multiple of the number of distinct 
+// rows.  If that leaves it more than half full, its capacity is doubled
+// so that it is not sorted again after just a few more rows.
+void push_unique( vector<row>& v, const row& r )
+{
+  if ( v.size() == v.capacity() && v.size() >= 1024 ) {
+    sort_unique(v);
+    if ( 2 * v.size() > v.capacity() ) 
+      v.reserve( 2 * v.capacity() );
+  }
+  v.push_back(r);
+}
+
+// The caches of falseness tables, keyed by the methods' place notation 
+// and the flags.
+template <class Table>
+class table_cache
+{
+public:
+  typedef pair< pair< vector<change>, vector<change> >, int > key_type;
+
+  table_cache() : limit(256) {}
+
+  bool find( const key_type& k, Table& t ) 
+  {
+    mutex::scoped_lock l(m);
+    typename map<key_type, Table>::const_iterator i( c.find(k) );
+    if ( i == c.end() ) return false;
+    t = i->second;
+    return true;
+  }
+
+  void insert( const key_type& k, const Table& t )
+  {
+    mutex::scoped_lock l(m);
+    if ( c.size() >= limit ) c.clear();
+    if ( limit ) c[k] = t;
+  }
+
+  void set_limit( size_t n ) 
+  {
+    mutex::scoped_lock l(m);
+    limit = n;
+    if ( c.size() > limit ) c.clear();
+  }
+
+private:
+  mutex m;
+  size_t limit;
+  map<key_type, Table> c;
+};
+
+table_cache<falseness_table> falseness_tables;
+table_cache<false_courses> false_course_tables;
+
+table_cache<falseness_table>::key_type 
+cache_key( const method& a, const method& b, int flags )
+{
+  return make_pair( make_pair( static_cast< vector<change> const& >(a), 
+                               static_cast< vector<change> const& >(b) ),
+                    flags );
+}
+
+RINGING_END_ANON_NAMESPACE
+
 falseness_table::falseness_table()
   : t(1, row())
 {}
@@ -73,12 +150,14 @@ void falseness_table::init( vector<row> const& m1, vector<row> const& m2 )
   // where A is the set of rows in the first lead of the first method,
   // similarly for B and the second method. 
 
-  set<row> fs;
-
   vector<row>::const_iterator const
     e1( flags & half_lead_only ?  m1.begin() + m1.size() / 2 : m1.end() ),
     e2( flags & half_lead_only ?  m2.begin() + m2.size() / 2 : m2.end() );
 
+  vector<row> fs;
+  fs.reserve( min( size_t(4096), size_t( (e1 - m1.begin()) 
+                                         * (e2 - m2.begin()) ) ) );
+
   for ( vector<row>::const_iterator i1( m1.begin() ); i1 != e1; ++i1 )
     {
       for ( vector<row>::const_iterator i2( m2.begin() ); i2 != e2; ++i2 )
@@ -93,13 +172,13 @@ void falseness_table::init( vector<row> const& m1, vector<row> const& m2 )
 	  if ( ( flags & out_of_course_only ) && f.sign() == +1 )
 	    continue;
 
-	  fs.insert( f );
+	  push_unique( fs, f );
 	}
     }
   
   // Put the falsenesses into the vector 
-  t.reserve( fs.size() );
-  copy( fs.begin(), fs.end(), back_inserter(t) );
+  sort_unique( fs );
+  t.assign( fs.begin(), fs.end() );
 }
 
 static int row_block_flags( int flags )
@@ -113,8 +192,13 @@ static int row_block_flags( int flags )
 falseness_table::falseness_table( const method &m, int flags )
   : flags(flags)
 {
+  table_cache<falseness_table>::key_type const k( cache_key( m, m, flags ) );
+  if ( falseness_tables.find( k, *this ) ) 
+    return;
+
   row_block rb(m, row_block_flags(flags));
   init( rb, rb );
+  falseness_tables.insert( k, *this );
 }
 
 falseness_table::falseness_table( const method &a, const vector<row>& b, 
@@ -127,8 +211,13 @@ falseness_table::falseness_table( const method &a, const vector<row>& b,
 falseness_table::falseness_table( const method &a, const method& b, int flags )
   : flags(flags)
 {
+  table_cache<falseness_table>::key_type const k( cache_key( a, b, flags ) );
+  if ( falseness_tables.find( k, *this ) ) 
+    return;
+
   init( row_block( a, row_block_flags(flags) ), 
         row_block( b, row_block_flags(flags) ) );
+  falseness_tables.insert( k, *this );
 }
 
 falseness_table::falseness_table( const vector<row> &a, const vector<row>& b, 
@@ -138,10 +227,15 @@ falseness_table::falseness_table( const vector<row> &a, const vector<row>& b,
   init( a, b );
 }
 
-group falseness_table::generate_group() const
+void falseness_table::cache_size( size_t n )
+{
+  falseness_tables.set_limit(n);
+}
+
+vector<row> falseness_table::group_generators() const
 {
   if ( !( flags & out_of_course_only ) )
-    return group(t);
+    return t;
 
   vector<row> t2; t2.reserve( t.size() * t.size() );
   for ( vector<row>::const_iterator i=t.begin(), e=t.end(); i!=e; ++i )
@@ -149,7 +243,17 @@ group falseness_table::generate_group() const
     t2.push_back( *i / *j );
     assert( t2.back().sign() == +1 );
   }
-  return group(t2);
+  return t2;
+}
+
+group falseness_table::generate_group() const
+{
+  return group( group_generators() );
+}
+
+size_t falseness_table::group_order() const
+{
+  return group( group_generators(), group::chained ).size();
 }
 
 false_courses::false_courses()
@@ -189,7 +293,7 @@ public:
 	     && !are_tenors_together( c, 6 ) )
 	  continue;
 
-	fs.insert( c );
+	push_unique( fs, c );
       }
     while ( !lead.isrounds() );
   }
@@ -197,18 +301,22 @@ public:
   void extract() 
   {
     // Put the falsenesses into the vector 
-    fc.t.reserve( fs.size() );
-    copy( fs.begin(), fs.end(), back_inserter( fc.t ) );
+    sort_unique( fs );
+    fc.t.assign( fs.begin(), fs.end() );
   }
 
 private:
   false_courses &fc;
-  set<row> fs;
+  vector<row> fs;
 };
 
 false_courses::false_courses( const method &m, int flags )
   : flags(flags), lh(m.lh())
 {
+  table_cache<false_courses>::key_type const k( cache_key( m, m, flags ) );
+  if ( false_course_tables.find( k, *this ) ) 
+    return;
+
   initialiser init( *this );
 
   method::const_iterator const e( m.end() );
@@ -223,6 +331,12 @@ false_courses::false_courses( const method &m, int flags )
     }
 
   init.extract();
+  false_course_tables.insert( k, *this );
+}
+
+void false_courses::cache_size( size_t n )
+{
+  false_course_tables.set_limit(n);
 }
 
 RINGING_START_ANON_NAMESPACE
@@ -88,8 +88,18 @@ public:
   // Use the falseness table as the generator set for a group
   group generate_group() const;
 
+  // The order of that group.  This uses a stabiliser chain rather than
+  // listing the elements, and so is much quicker for large groups.
+  size_t group_order() const;
+
+  // Tables made from methods are kept in a process-wide cache, so
+  // constructing the same table again is cheap.  This sets how many
+  // tables are kept; 0 disables the cache.
+  static void cache_size( size_t n );
+
 private:
   void init( vector<row> const& m1, vector<row> const& m2 );
+  vector<row> group_generators() const;
 
   vector<row> t;
   int flags;
@@ -131,6 +141,9 @@ public:
   // Look up a single symbol
   static string lookup_symbol( row const& fch );
 
+  // As falseness_table::cache_size
+  static void cache_size( size_t n );
+
 private:
   class initialiser;
   friend class initialiser;
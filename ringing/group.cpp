@@ -96,6 +96,182 @@ bool is_direct_product_of_symmetric_groups( vector< vector<bell> > const& o,
 
 RINGING_END_ANON_NAMESPACE
 
+stabiliser_chain::stabiliser_chain( const vector<row>& generators )
+  : b(0)
+{
+  for ( vector<row>::const_iterator 
+          i( generators.begin() ), e( generators.end() );  i != e;  ++i )
+    if ( size_t(i->bells()) > b ) 
+      b = i->bells();
+
+  levels.resize(b);
+  for ( size_t i=0; i<b; ++i )
+    calc_orbit(i);
+
+  for ( vector<row>::const_iterator 
+          i( generators.begin() ), e( generators.end() );  i != e;  ++i )
+    insert(*i);
+}
+
+// Sift r down the chain from level i, leaving the residue in r and 
+// returning the level at which it dropped out.  If r is in the
+// subgroup at level i, it ends up as rounds and b is returned.
+size_t stabiliser_chain::sift( row& r, size_t i ) const
+{
+  for ( ; i < b; ++i ) {
+    if ( size_t(r[i]) >= b ) 
+      return i;
+    row const& t = levels[i].trans[ r[i] ];
+    if ( t.bells() == 0 ) 
+      return i;
+    if ( size_t(r[i]) != i )
+      r = t.inverse() * r;
+  }
+  return b;
+}
+
+void stabiliser_chain::calc_orbit( size_t i )
+{
+  level& l = levels[i];
+  l.orbit.assign( 1u, bell(i) );
+  l.trans.assign( b, row() );
+  l.trans[i] = row(b);
+
+  for ( size_t j=0; j < l.orbit.size(); ++j ) {
+    row const& t = l.trans[ l.orbit[j] ];
+    for ( vector<row>::const_iterator 
+            k( l.gens.begin() ), e( l.gens.end() );  k != e;  ++k ) {
+      bell const x = (*k)[ l.orbit[j] ];
+      if ( l.trans[x].bells() == 0 ) {
+        l.trans[x] = *k * t;
+        l.orbit.push_back(x);
+      }
+    }
+  }
+}
+
+// r fixes places 0 to i-1, and so belongs to the subgroup at each level 
+// down to i.  
+void stabiliser_chain::add_generator( const row& r, size_t i )
+{
+  gens.push_back(r);
+  for ( size_t j=0; j<=i; ++j ) {
+    levels[j].gens.push_back(r);
+    calc_orbit(j);
+  }
+}
+
+// The Schreier-Sims algorithm.  Everything below level i is already a
+// stabiliser chain for its subgroup: check that the Schreier generators
+// at level i lie in the next level down, adding their residues to the 
+// chain if not and restarting from the level they were added at.
+void stabiliser_chain::close( size_t i )
+{
+  while (true) {
+    bool extended = false;
+
+    for ( size_t j=0; !extended && j < levels[i].orbit.size(); ++j ) {
+      level const& l = levels[i];
+      row const& t = l.trans[ l.orbit[j] ];
+      for ( size_t k=0; k < l.gens.size(); ++k ) {
+        row const& g = l.gens[k];
+        row s( l.trans[ g[ l.orbit[j] ] ].inverse() * g * t );
+        size_t const m = sift( s, i+1 );
+        if ( m != b ) {
+          add_generator( s, m );
+          i = m; extended = true;
+          break;
+        }
+      }
+    }
+
+    if ( !extended ) {
+      if ( i == 0 ) break;
+      --i;
+    }
+  }
+}
+
+void stabiliser_chain::insert( const row& r0 )
+{
+  if ( size_t(r0.bells()) > b ) {
+    // A generator on more bells: start again with a bigger chain
+    vector<row> g( gens );
+    g.push_back(r0);
+    *this = stabiliser_chain(g);
+    return;
+  }
+
+  row r( row(b) * r0 );
+  size_t const i = sift(r);
+  if ( i != b ) {
+    add_generator( r, i );
+    close(i);
+  }
+}
+
+RINGING_ULLONG stabiliser_chain::order() const
+{
+  RINGING_ULLONG n = 1;
+  for ( vector<level>::const_iterator i( levels.begin() ), e( levels.end() );
+        i != e; ++i )
+    n *= i->orbit.size();
+  return n;
+}
+
+bool stabiliser_chain::contains( const row& r0 ) const
+{
+  row r( row(b) * r0 );
+  sift(r);
+  return r.isrounds();
+}
+
+// Each level leaves the earlier places alone, so the least element of
+// r H, where H is the subgroup at level i, can be found one place at a 
+// time.
+row stabiliser_chain::lcoset_label( row r, size_t i ) const
+{
+  for ( ; i < b; ++i ) {
+    level const& l = levels[i];
+    bell x = l.orbit.front();
+    for ( vector<bell>::const_iterator j( l.orbit.begin() ), 
+            e( l.orbit.end() );  j != e;  ++j )
+      if ( r[*j] < r[x] ) 
+        x = *j;
+    if ( size_t(x) != i )
+      r = r * l.trans[x];
+  }
+  return r;
+}
+
+row stabiliser_chain::lcoset_label( const row& r ) const
+{
+  return lcoset_label( row(b) * r, 0 );
+}
+
+// Gr is the inverse of the left coset r^-1 G.
+row stabiliser_chain::rcoset_label( const row& r ) const
+{
+  return lcoset_label( row(b) * r.inverse(), 0 ).inverse();
+}
+
+// The orbit at each level is determined by the group; so too is each
+// coset of the next level down, which we can represent by its least 
+// element.
+vector<row> stabiliser_chain::canonical_form() const
+{
+  vector<row> f;
+  for ( size_t i=0; i<b; ++i ) {
+    vector<bell> o( levels[i].orbit );
+    sort( o.begin(), o.end() );
+    for ( vector<bell>::const_iterator j( o.begin() ), e( o.end() ); 
+          j != e; ++j )
+      if ( size_t(*j) != i ) 
+        f.push_back( lcoset_label( levels[i].trans[*j], i+1 ) );
+  }
+  return f;
+}
+
 group group::symmetric_group(int nw, int nh, int nt)
 {
   if (!nt) nt = nh + nw;
@@ -172,10 +348,56 @@ group::group( const vector<row>& gens )
   calc_orbit_space();
 }
 
+group::group( const vector<row>& gens, storage s )
+  : b(0)
+{
+  if ( s == enumerated ) { 
+    group(gens).swap(*this); 
+    return;
+  }
+
+  c = stabiliser_chain( gens );
+  b = c.bells();
+  v.clear();
+  calc_orbit_space();
+}
+
+const stabiliser_chain& group::chain() const
+{
+  if ( !is_chained() && c.bells() != b )
+    c = stabiliser_chain( v );
+  return c;
+}
+
+bool group::contains( const row& r ) const
+{
+  if ( is_chained() ) 
+    return c.contains(r);
+  else
+    return find( v.begin(), v.end(), r ) != v.end();
+}
+
+void group::swap( group& g ) 
+{
+  RINGING_PREFIX_STD swap( b, g.b );
+  v.swap(g.v); 
+  RINGING_PREFIX_STD swap( c, g.c );
+  o.swap(g.o);
+}
+
 group group::conjugate( const row& r ) const
 {
   group g;
 
+  if ( is_chained() ) {
+    const row ri( r.inverse() );
+    vector<row> gens;
+    for ( vector<row>::const_iterator i( c.generators().begin() ), 
+            e( c.generators().end() );  i != e;  ++i )
+      gens.push_back( ri * *i * r );
+    return group( gens, chained );
+  }
+
   g.b = b;
   g.v.clear();  // Default constructor populates it with a single element
   g.v.reserve( v.size() );
@@ -193,27 +415,41 @@ group group::conjugate( const row& r ) const
   return g;
 }
 
+// Chained groups have no list of elements to compare, so compare the
+// canonical forms of their stabiliser chains instead.
 bool operator==( const group& a, const group& b )
 {
+  if ( a.is_chained() || b.is_chained() )
+    return a.b == b.b && a.size() == b.size() 
+      && a.chain().canonical_form() == b.chain().canonical_form();
+
   return a.b == b.b && a.v == b.v;
 }
 
 bool operator<( const group& a, const group& b )
 {
+  if ( a.is_chained() || b.is_chained() )
+    return a.b < b.b || ( a.b == b.b && 
+      ( a.size() < b.size() || ( a.size() == b.size() &&
+        a.chain().canonical_form() < b.chain().canonical_form() ) ) );
+
   return a.b < b.b || a.b == b.b && a.v < b.v;
 }
 
 bool operator>( const group& a, const group& b )
 {
-  return a.b > b.b || a.b == b.b && a.v > b.v;
+  return b < a;
 }
 
 row group::rcoset_label( row const& r ) const
 {
+  if ( is_chained() ) return c.rcoset_label(r);
+
   if ( size() == 1 ) return r;
 
   // |G|=6 is the point at which the O(1) algorithm beats the O(|G|) one.
-  if ( size() >= 6 && is_direct_product_of_symmetric_groups( o, size() ) ) 
+  if ( size() >= 6 && size_t(r.bells()) == bells() 
+       && is_direct_product_of_symmetric_groups( o, size() ) ) 
   {
     // Use an O(1) algorithm.
     vector<bell> label( r.bells() );
@@ -248,6 +484,8 @@ row group::rcoset_label( row const& r ) const
 
 row group::lcoset_label( row const& r ) const
 {
+  if ( is_chained() ) return c.lcoset_label(r);
+
   row label;
   for ( const_iterator i=v.begin(), e=v.end(); i != e; ++i ) 
   {
@@ -265,6 +503,21 @@ void group::calc_orbit_space() const
   for ( const_iterator i=v.begin(), e=v.end(); i != e; ++i ) 
     for ( size_t j=0; j<bells(); ++j )
       orbs[j].insert( (*i)[j] );
+
+  if ( is_chained() ) {
+    // Orbits are the closures of the generators' orbits
+    for ( size_t j=0; j<bells(); ++j ) {
+      orbs[j].insert( bell(j) );
+      vector<bell> x( 1u, bell(j) );
+      while ( x.size() ) {
+        bell const k = x.back(); x.pop_back();
+        for ( vector<row>::const_iterator i( c.generators().begin() ),
+                e( c.generators().end() );  i != e;  ++i ) 
+          if ( orbs[j].insert( (*i)[k] ).second )
+            x.push_back( (*i)[k] );
+      }
+    }
+  }
  
   o.clear(); 
   for ( size_t j=0; j<bells(); ++j ) {
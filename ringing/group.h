@@ -41,6 +41,61 @@ RINGING_START_NAMESPACE
 
 RINGING_USING_STD
 
+// --------------------------------------------------------------
+//
+// A stabiliser chain for a permutation group, built from its 
+// generators using the Schreier-Sims algorithm.  The base is always 
+// 0, 1, ..., n-1, so the ith level of the chain is the subgroup 
+// fixing the first i places together with a transversal of the 
+// orbit of place i under that subgroup.  This is small even when the 
+// group itself is large.
+//
+class RINGING_API stabiliser_chain
+{
+public:
+  stabiliser_chain() : b(0) {}
+  explicit stabiliser_chain( const vector<row>& generators );
+
+  size_t bells() const { return b; }
+
+  // Add a further element to the group, extending the chain as needed.
+  void insert( const row& r );
+
+  RINGING_ULLONG order() const;
+  bool contains( const row& r ) const;
+
+  // The lexicographically least element of the left coset rG, and a 
+  // canonical (but not, in general, the least) element of the right 
+  // coset Gr.
+  row lcoset_label( const row& r ) const;
+  row rcoset_label( const row& r ) const;
+
+  // A strong generating set for the group
+  const vector<row>& generators() const { return gens; }
+
+  // A list of elements that is the same for any two chains
+  // representing the same group
+  vector<row> canonical_form() const;
+
+private:
+  struct level 
+  {
+    vector<row> gens;   // The strong generators fixing the earlier places
+    vector<bell> orbit; // The orbit of this place under them, and
+    vector<row> trans;  // trans[x] maps this place to x, if x is in it
+  };
+
+  size_t sift( row& r, size_t from = 0 ) const;
+  row lcoset_label( row r, size_t from ) const;
+  void calc_orbit( size_t i );
+  void add_generator( const row& r, size_t i );
+  void close( size_t i );
+
+  size_t b;
+  vector<row> gens;
+  vector<level> levels;
+};
+
 // --------------------------------------------------------------
 //
 // Geneates a group from a set of generators 
@@ -48,20 +103,37 @@ RINGING_USING_STD
 class RINGING_API group
 {
 public:
+  // How the group is stored.  An enumerated group holds a list of all
+  // of its elements.  A chained group holds only a stabiliser chain;
+  // this is much smaller and quicker to construct for large groups,
+  // but its elements cannot be iterated through.
+  enum storage { enumerated, chained };
+
   group() : b(0), v(1u) {} // The group containing just the identity
   explicit group( const row& generator );
   explicit group( const row& generator1, const row& generator2 );
   explicit group( const vector<row> &generators );
+  group( const vector<row> &generators, storage s );
 
   size_t bells() const { return b; }
 
-  // Container interface
+  // Container interface.  A chained group is an empty range.
   typedef vector<row>::const_iterator const_iterator;
   const_iterator begin() const { return v.begin(); }
   const_iterator end()   const { return v.end();   }
-  size_t         size()  const { return v.size();  }
+  size_t         size()  const 
+    { return v.empty() ? size_t( c.order() ) : v.size(); }
+
+  bool is_chained() const { return v.empty(); }
+  bool contains( const row& r ) const;
+
+  // The stabiliser chain.  A chained group builds it when constructed,
+  // so this only reads it.  An enumerated group creates it on demand,
+  // so calling this on an enumerated group shared between threads is 
+  // not thread-safe unless it has already been called once.
+  const stabiliser_chain& chain() const;
 
-  void swap( group& g ) { v.swap(g.v); }
+  void swap( group& g );
 
   // Named constructors
   static group symmetric_group(int nw, int nh = 0, int nt = 0);
@@ -81,7 +153,9 @@ public:
   // Choose a element of the left coset rG or right coset Gr as a canonical 
   // label for it.  The element chosen is the lexicographically least element; 
   // thus if r \in G the label is rounds.  For part end groups, you typically
-  // want right cosets.
+  // want right cosets.  For a chained group, rcoset_label still picks a
+  // canonical element, and rounds if r \in G, but not necessarily the
+  // least one.
   row rcoset_label( row const& r ) const;
   row lcoset_label( row const& r ) const;
 
@@ -93,6 +167,7 @@ private:
   size_t b;
   vector<row> v;
 
+  mutable stabiliser_chain c;       // Created on demand if enumerated
   mutable vector< vector<bell> > o; // Created on demand
 };
 
@@ -28,21 +28,39 @@
 #if RINGING_OLD_INCLUDES
 #include <iostream.h>
 #include <iomanip.h>
-#include <map.h>
+#include <fstream.h>
+#include <iterator.h>
 #include <set.h>
+#include <stdexcept.h>
 #else
 #include <iostream>
 #include <iomanip>
-#include <map>
+#include <fstream>
+#include <iterator>
 #include <set>
+#include <stdexcept>
 #endif
 #if RINGING_OLD_C_INCLUDES
 #include <assert.h>
 #include <math.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
 #else
 #include <cassert>
 #include <cmath>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #endif
+#if RINGING_HAVE_MMAP
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <ringing/streamutils.h>
 
 RINGING_START_NAMESPACE
 
@@ -56,12 +74,32 @@ int multtab::bells() const
 void multtab::swap( multtab &other )
 {
   rows.swap( other.rows );
-  table.swap( other.table );
+  slots.swap( other.slots );
+  RINGING_PREFIX_STD swap( narrow, other.narrow );
+  RINGING_PREFIX_STD swap( stride, other.stride );
+  table16.swap( other.table16 );
+  table32.swap( other.table32 );
+  RINGING_PREFIX_STD swap( data16, other.data16 );
+  RINGING_PREFIX_STD swap( data32, other.data32 );
+  mapped.swap( other.mapped );
+  RINGING_PREFIX_STD swap( key, other.key );
+  RINGING_PREFIX_STD swap( from_cache, other.from_cache );
   pends.swap( other.pends );
   postgroup.swap( other.postgroup );
   cols.swap( other.cols );
 }
 
+multtab::multtab( const multtab &other )
+  : narrow( other.narrow ), stride( other.stride ), 
+    table16( other.table16 ), table32( other.table32 ),
+    data16( other.data16 ), data32( other.data32 ), mapped( other.mapped ),
+    key( other.key ), from_cache( other.from_cache ),
+    rows( other.rows ), slots( other.slots ), 
+    pends( other.pends ), postgroup( other.postgroup ), cols( other.cols )
+{
+  set_data();
+}
+
 multtab &multtab::operator=( const multtab &other ) 
 { 
   multtab(other).swap(*this);
@@ -80,8 +118,7 @@ row multtab::make_post_representative( const row& r ) const
       row const x( r * *i );
       if ( (res.bells() == 0 || x < res) && 
            // Handle case where pends and postgroup are not subsets of rows
-           RINGING_PREFIX_STD find( rows.begin(), rows.end(), 
-                                    x ) != rows.end() )
+           find_index(x) != rows.size() )
         res = x;
     }
 
@@ -90,6 +127,12 @@ row multtab::make_post_representative( const row& r ) const
 
 row multtab::make_representative( const row& r ) const
 {
+  // Without a post group, this is just the least element of the part 
+  // end coset -- or, if the part ends are a chained group, the 
+  // canonical one.  Either way, group knows how to find it quickly.
+  if ( postgroup.size() < 2 )
+    return pends.rcoset_label( r );
+
   row res(r);
 
   for ( group::const_iterator i( pends.begin() ), e( pends.end() ); 
@@ -112,7 +155,14 @@ void multtab::init( const vector< row >& r )
   // group, <13425678, 12345786>.)
   
 
+  if ( ( postgroup.is_chained() || pends.is_chained() ) 
+       && postgroup.size() > 1 )
+    throw logic_error
+      ( "A multiplication table with a post group requires both groups "
+        "to be enumerated" );
+
   rows = r; // so that we can call make_representative, below
+  index_rows();
 
   set<row> rows2;
 
@@ -130,30 +180,440 @@ void multtab::init( const vector< row >& r )
 
   copy( rows2.begin(), rows2.end(), back_inserter(rows) );
 
-  table.resize( rows.size() );
+  init_table();
+}
+
+void multtab::init_table()
+{
+  narrow = rows.size() <= size_t(USHRT_MAX) + 1;
+  stride = 0;
+  key = 0;  from_cache = false;
+
+  if ( rows.size() > size_t(UINT_MAX) )
+    throw out_of_range( "Too many rows for a multiplication table" );
+
+  index_rows();
+  set_data();
+}
+
+void multtab::set_data()
+{
+  if ( !mapped ) {
+    data16 = table16.empty() ? 0 : &table16[0];
+    data32 = table32.empty() ? 0 : &table32[0];
+  }
+}
+
+void multtab::index_rows()
+{
+  // Keep the table at most half full
+  size_t n = 16;
+  while ( n < 2 * rows.size() ) n *= 2;
+  slots.assign( n, 0 );
+
+  size_t const mask = n - 1;
+  for ( size_t r = 0; r < rows.size(); ++r ) {
+    size_t i = rows[r].hash() & mask;
+    while ( slots[i] && rows[ slots[i]-1 ] != rows[r] ) 
+      i = (i+1) & mask;
+    // If a row is listed twice, the first occurrence is found
+    if ( !slots[i] ) slots[i] = r+1;
+  }
+}
+
+size_t multtab::find_index( const row &r ) const
+{
+  size_t const mask = slots.size() - 1;
+  size_t i = r.hash() & mask;
+  while ( slots[i] ) {
+    if ( rows[ slots[i]-1 ] == r ) return slots[i]-1;
+    i = (i+1) & mask;
+  }
+  return rows.size();
+}
+
+size_t multtab::column_entry( const row &r ) const
+{
+  // Products that fall outside the table have always been mapped to 
+  // the first row
+  size_t const i = find_index(r);
+  return i == rows.size() ? 0 : i;
+}
+
+RINGING_START_ANON_NAMESPACE
+
+template <class T>
+void add_column( vector<T>& table, size_t& stride, size_t c, 
+                 vector<size_t> const& col )
+{
+  size_t const n = col.size();
+  if ( c == stride ) {
+    size_t const s2 = stride ? 2*stride : 4;
+    vector<T> t2( n * s2 );
+    for ( size_t i = 0; i < n; ++i )
+      copy( table.begin() + i*stride, table.begin() + i*stride + c,
+            t2.begin() + i*s2 );
+    table.swap(t2);  stride = s2;
+  }
+  for ( size_t i = 0; i < n; ++i )
+    table[ i*stride + c ] = col[i];
+}
+
+RINGING_END_ANON_NAMESPACE
+
+void multtab::add_column( vector< size_t > const& col )
+{
+  assert( col.size() == rows.size() );
+
+  // A table read from a cache file must be copied before changing it
+  if ( mapped ) {
+    size_t const n = rows.size() * stride;
+    if ( narrow ) table16.assign( data16, data16 + n );
+    else          table32.assign( data32, data32 + n );
+    mapped.reset();
+  }
+  from_cache = false;
+
+  if ( narrow ) 
+    RINGING_PREFIX add_column( table16, stride, cols.size(), col );
+  else
+    RINGING_PREFIX add_column( table32, stride, cols.size(), col );
+  set_data();
+}
+
+// ---------------------------------------------------------------------
+//
+// Cache files.
+//
+// A cache file starts with a cache_header, which is followed by the 
+// bells of each row, and a byte saying whether each column is a pre- 
+// or post-multiplication followed by the bells of its row.  The table 
+// itself starts at the next multiple of eight bytes, and is laid out 
+// exactly as in memory.  Everything is in the native byte order; a 
+// file written on a different architecture is simply not recognised.
+
+RINGING_START_ANON_NAMESPACE
+
+struct cache_header 
+{
+  char magic[8];
+  unsigned int byte_order, version, bells, narrow;
+  RINGING_ULLONG key, rows, cols, stride;
+};
+
+char const cache_magic[8] = { 'M', 'U', 'L', 'T', 'T', 'A', 'B', 0 };
+unsigned int const cache_byte_order = 0x01020304u;
+unsigned int const cache_version = 1u;
+
+size_t cache_table_offset( cache_header const& h )
+{
+  size_t const n = sizeof(h) + h.rows * h.bells + h.cols * (1 + h.bells);
+  return (n + 7) & ~size_t(7);
+}
+
+// Read the bells of a row into b, checking that they form a permutation
+bool read_cache_row( char const*& p, vector<bell>& b )
+{
+  vector<bool> seen( b.size() );
+  for ( size_t j = 0; j < b.size(); ++j ) {
+    unsigned char const x = *p++;
+    if ( x >= b.size() || seen[x] ) 
+      return false;
+    seen[x] = true;
+    b[j] = x;
+  }
+  return true;
+}
+
+// Check that the entries in the columns in use are all row indices
+template <class T>
+bool valid_cache_table( T const* t, cache_header const& h )
+{
+  for ( size_t i = 0; i < h.rows; ++i, t += h.stride )
+    for ( size_t j = 0; j < h.cols; ++j )
+      if ( t[j] >= h.rows ) 
+        return false;
+  return true;
+}
+
+// The key is a 64-bit FNV-1a hash of everything used to build the 
+// table (except the columns, which are saved with it).
+void hash_byte( RINGING_ULLONG& h, unsigned char c )
+{
+  h ^= c;  h *= ((RINGING_ULLONG) 1 << 40) + 0x1b3;
+}
+
+void hash_size( RINGING_ULLONG& h, size_t n )
+{
+  for ( int i = 0; i < 4; ++i, n >>= 8 ) 
+    hash_byte( h, n & 0xFF );
+}
+
+void hash_row( RINGING_ULLONG& h, row const& r )
+{
+  hash_size( h, r.bells() );
+  for ( int i = 0; i < r.bells(); ++i )
+    hash_byte( h, r[i] );
+}
+
+RINGING_END_ANON_NAMESPACE
+
+// The contents of a cache file: mapped into memory where possible, 
+// and read into a buffer otherwise.
+class multtab::mapping
+{
+public:
+  explicit mapping( string const& filename );
+ ~mapping();
+
+  char const* data() const;
+  size_t size() const;
+
+private:
+  // Unimplemented
+  mapping( mapping const& );
+  mapping& operator=( mapping const& );
+
+#if RINGING_HAVE_MMAP
+  void* addr;
+  size_t len;
+#else
+  vector<char> buf;
+#endif
+};
+
+#if RINGING_HAVE_MMAP
+
+multtab::mapping::mapping( string const& filename )
+  : addr(0), len(0)
+{
+  int const fd = open( filename.c_str(), O_RDONLY );
+  if ( fd == -1 ) return;
+
+  struct stat st;
+  if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+    void* const p = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if ( p != MAP_FAILED ) { addr = p;  len = st.st_size; }
+  }
+  close( fd );
+}
+
+multtab::mapping::~mapping()
+{
+  if ( addr ) munmap( addr, len );
+}
+
+char const* multtab::mapping::data() const 
+{ 
+  return static_cast<char const*>( addr ); 
+}
+
+size_t multtab::mapping::size() const { return len; }
+
+#else
+
+multtab::mapping::mapping( string const& filename )
+{
+  ifstream in( filename.c_str(), ios::in | ios::binary );
+  if ( in ) 
+    buf.assign( istreambuf_iterator<char>( in ), 
+                istreambuf_iterator<char>() );
+}
+
+multtab::mapping::~mapping() {}
+
+char const* multtab::mapping::data() const 
+{ 
+  return buf.empty() ? 0 : &buf[0]; 
+}
+
+size_t multtab::mapping::size() const { return buf.size(); }
+
+#endif // RINGING_HAVE_MMAP
+
+void multtab::init( const vector< row >& r, const string& cache_file, 
+                    bool is_square )
+{
+  RINGING_ULLONG k = ((RINGING_ULLONG) 0xcbf29ce4u << 32) | 0x84222325u;
+  hash_size( k, cache_version );
+  hash_size( k, is_square );
+  hash_size( k, r.size() );
+  for ( vector<row>::const_iterator i( r.begin() ), e( r.end() ); 
+        i != e; ++i ) 
+    hash_row( k, *i );
+  hash_size( k, pends.size() );
+  for ( group::const_iterator i( pends.begin() ), e( pends.end() ); 
+        i != e; ++i )
+    hash_row( k, *i );
+  if ( pends.is_chained() ) {
+    vector<row> const& gens = pends.chain().generators();
+    for ( vector<row>::const_iterator i( gens.begin() ), e( gens.end() ); 
+          i != e; ++i )
+      hash_row( k, *i );
+  }
+  hash_size( k, postgroup.size() );
+  for ( group::const_iterator i( postgroup.begin() ), e( postgroup.end() ); 
+        i != e; ++i )
+    hash_row( k, *i );
+
+  key = k;
+  if ( load( cache_file ) ) 
+    return;
+
+  if ( is_square ) {
+    rows = r;
+    init_table();
+  }
+  else 
+    init( r );
+  key = k;
+}
+
+bool multtab::load( const string& filename )
+{
+  if ( filename.empty() ) 
+    return false;
+
+  shared_pointer<mapping> m( new mapping( filename ) );
+
+  cache_header h;
+  if ( m->size() < sizeof(h) ) 
+    return false;
+  memcpy( &h, m->data(), sizeof(h) );
+
+  size_t const width = h.narrow ? sizeof(unsigned short) 
+                                : sizeof(unsigned int);
+  // Bound the counts by the file size first, so that the size check 
+  // cannot overflow
+  if ( memcmp( h.magic, cache_magic, sizeof(h.magic) ) != 0 
+       || h.byte_order != cache_byte_order || h.version != cache_version
+       || h.key != key || h.cols > h.stride
+       || h.bells == 0 || h.bells > bell::MAX_BELLS
+       || h.rows > m->size() || h.stride > m->size()
+       || m->size() != cache_table_offset(h) + h.rows * h.stride * width )
+    return false;
+
+  // The file may have been corrupted without changing its header or 
+  // size, so check that the rows are permutations and the entries are 
+  // indices into the rows before trusting them.
+  char const* p = m->data() + sizeof(h);
+  vector<bell> b( h.bells );
+
+  vector<row> r;  r.reserve( h.rows );
+  for ( size_t i = 0; i < h.rows; ++i ) {
+    if ( !read_cache_row( p, b ) ) return false;
+    r.push_back( row(b) );
+  }
+
+  vector< pair< row, pre_or_post > > c;  c.reserve( h.cols );
+  for ( size_t i = 0; i < h.cols; ++i ) {
+    pre_or_post const pp = *p++ ? post_mult : pre_mult;
+    if ( !read_cache_row( p, b ) ) return false;
+    c.push_back( make_pair( row(b), pp ) );
+  }
+
+  char const* const t = m->data() + cache_table_offset(h);
+  if ( h.narrow 
+       ? !valid_cache_table( reinterpret_cast<unsigned short const*>(t), h )
+       : !valid_cache_table( reinterpret_cast<unsigned int const*>(t), h ) )
+    return false;
+
+  rows.swap(r);  cols.swap(c);
+  narrow = h.narrow;  stride = h.stride;
+  vector< unsigned short >().swap( table16 );
+  vector< unsigned int >().swap( table32 );
+
+  data16 = narrow ? reinterpret_cast<unsigned short const*>(t) : 0;
+  data32 = narrow ? 0 : reinterpret_cast<unsigned int const*>(t);
+  mapped = m;
+  from_cache = true;
+
+  index_rows();
+  return true;
+}
+
+bool multtab::save( const string& filename ) const
+{
+  if ( filename.empty() ) 
+    return false;
+
+  cache_header h;
+  memcpy( h.magic, cache_magic, sizeof(h.magic) );
+  h.byte_order = cache_byte_order;  h.version = cache_version;
+  h.bells = bells();  h.narrow = narrow;
+  h.key = key;  h.rows = rows.size();  h.cols = cols.size();  
+  h.stride = stride;
+
+  // Write to a temporary file and rename it, so that another process
+  // never sees a partly written table.
+#if RINGING_HAVE_MMAP
+  string const tmp( make_string() << filename << "." << getpid() );
+#else
+  string const tmp( filename + ".tmp" );
+#endif
+  {
+    ofstream out( tmp.c_str(), ios::out | ios::binary | ios::trunc );
+    out.write( reinterpret_cast<char const*>( &h ), sizeof(h) );
+
+    for ( vector<row>::const_iterator i( rows.begin() ), e( rows.end() ); 
+          i != e; ++i )
+      for ( int j = 0; j < i->bells(); ++j )
+        out.put( (char) (*i)[j] );
+
+    for ( size_t i = 0; i < cols.size(); ++i ) {
+      out.put( cols[i].second == post_mult );
+      for ( int j = 0; j < cols[i].first.bells(); ++j )
+        out.put( (char) cols[i].first[j] );
+    }
+
+    for ( size_t n = sizeof(h) + h.rows * h.bells + h.cols * (1 + h.bells);
+          n < cache_table_offset(h); ++n )
+      out.put( 0 );
+
+    size_t const n = rows.size() * stride;
+    if ( n && narrow ) 
+      out.write( reinterpret_cast<char const*>( data16 ), 
+                 n * sizeof(unsigned short) );
+    else if ( n )
+      out.write( reinterpret_cast<char const*>( data32 ), 
+                 n * sizeof(unsigned int) );
+
+    out.close();
+    if ( !out ) {
+      remove( tmp.c_str() );
+      return false;
+    }
+  }
+
+  // Some platforms will not rename over an existing file
+  if ( rename( tmp.c_str(), filename.c_str() ) != 0 ) {
+    remove( filename.c_str() );
+    if ( rename( tmp.c_str(), filename.c_str() ) != 0 ) {
+      remove( tmp.c_str() );
+      return false;
+    }
+  }
+  return true;
 }
 
 void multtab::dump( ostream &os ) const
 {
-  const int width( (int)ceil( log10( (float)table.size() ) ) );
+  const int width( (int)ceil( log10( (float)size() ) ) );
 
   // Column headings
-  if ( table.size() )
+  if ( size() )
     {
       os << string( width + 5 + rows[0].bells(), ' ' );
-      for ( size_t j = 0; j < table[0].size(); ++j )
+      for ( size_t j = 0; j < cols.size(); ++j )
         os << setw(width) << j << " ";
       os << "\n";
     }
 
-  for ( row_t i; i.n != table.size(); ++i.n )
+  for ( row_t i; i.n != size(); ++i.n )
     {
       os << setw(width) << i.n << ")  " << rows[i.n] << "  ";
-      for ( vector< row_t >::const_iterator j( table[i.n].begin() );
-            j != table[i.n].end(); ++j )
-        {
-          os << setw(width) << j->n << " ";
-        }
+      for ( size_t j = 0; j < cols.size(); ++j )
+        os << setw(width) << lookup( i.n, j ) << " ";
       os << "\n";
     }
 
@@ -163,10 +623,15 @@ void multtab::dump( ostream &os ) const
 multtab::pre_col_t 
 multtab::compute_pre_mult( const row &r )
 {
-  // This only makes sense if r commutes with the partends
-  for ( vector<row>::const_iterator i( pends.begin() ), e( pends.end() ); 
-          i != e; ++i )
-    if ( r * *i != *i * r )
+  // This only makes sense if r commutes with the partends.  (For a 
+  // chained group it is enough to check the generators.)
+  group::const_iterator p( pends.begin() ), pe( pends.end() );
+  if ( pends.is_chained() ) {
+    p = pends.chain().generators().begin();
+    pe = pends.chain().generators().end();
+  }
+  for ( ; p != pe; ++p )
+    if ( r * *p != *p * r )
       throw logic_error
         ( "Attempted to add a precomputed premultiplication to the "
           "multiplication table that does not commute with the part ends" );
@@ -175,16 +640,10 @@ multtab::compute_pre_mult( const row &r )
     if ( cols[i].second == pre_mult && cols[i].first == r )
       return pre_col_t( i, this );
 
-  // Build up a map in O(n) to get O(ln n) lookups.
-  // The alternative -- doing direct lookups -- is
-  // O(n ln n).  For a 1-part table on 8 bells, this
-  // improves speed a factor of over 100.
-  map< row, row_t > finder;
-  for ( size_t i(0); i < table.size(); ++i )
-    finder[ rows[i] ] = row_t::from_index(i);
-
-  for ( size_t i(0); i < table.size(); ++i )
-    table[i].push_back( finder[ make_representative( r * rows[i] ) ] );
+  vector< size_t > col( size() );
+  for ( size_t i(0); i < size(); ++i )
+    col[i] = column_entry( make_representative( r * rows[i] ) );
+  add_column( col );
   
   cols.push_back( make_pair( r, pre_mult ) );
   return pre_col_t( cols.size() - 1, this );
@@ -205,16 +664,10 @@ multtab::compute_post_mult( const row &r )
     if ( cols[i].second == post_mult && cols[i].first == r )
       return post_col_t( i, this );
 
-  // Build up a map in O(n) to get O(ln n) lookups.
-  // The alternative -- doing direct lookups -- is
-  // O(n ln n).  For a 1-part table on 8 bells, this
-  // improves speed a factor of over 100.
-  map< row, row_t > finder;
-  for ( size_t i(0); i < table.size(); ++i )
-    finder[ rows[i] ] = row_t::from_index(i);
-
-  for ( size_t i(0); i < table.size(); ++i )
-    table[i].push_back( finder[ make_representative( rows[i] * r ) ] );
+  vector< size_t > col( size() );
+  for ( size_t i(0); i < size(); ++i )
+    col[i] = column_entry( make_representative( rows[i] * r ) );
+  add_column( col );
 
   cols.push_back( make_pair( r, post_mult ) );
   return post_col_t( cols.size() - 1, this );
@@ -223,14 +676,9 @@ multtab::compute_post_mult( const row &r )
 multtab::row_t 
 multtab::find( const row &r ) const
 {
-  row r2( make_representative( r ) );
-
-  for ( row_t i; i.n != rows.size(); ++i.n )
-    if ( rows[i.n] == r2 ) 
-      return i;
-
-  assert( false );
-  return row_t();
+  size_t const i = find_index( make_representative( r ) );
+  assert( i != rows.size() );
+  return row_t::from_index( i );
 }
 
 row multtab::find( const multtab::row_t &r ) const
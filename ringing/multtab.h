@@ -33,14 +33,17 @@
 
 #include <ringing/row.h>
 #include <ringing/group.h>
+#include <ringing/pointers.h>
 #if RINGING_OLD_INCLUDES
 #include <iosfwd.h>
+#include <string.h>
 #include <vector.h>
 #include <algo.h>
 #include <iterator.h>
 #include <functional.h>
 #else
 #include <iosfwd>
+#include <string>
 #include <vector>
 #include <algorithm>
 #include <iterator>
@@ -230,8 +233,9 @@ RINGING_END_DETAILS_NAMESPACE
 class RINGING_API multtab
 {
 public:
-  // A swap function and assignment operator
+  // A swap function, copy constructor and assignment operator
   void swap( multtab &other );
+  multtab( const multtab &other );
   multtab &operator=( const multtab &other );
 
   // Initialises a multiplication table with the rows in the 
@@ -239,7 +243,7 @@ public:
   template < class InputIterator >
   multtab( InputIterator first, InputIterator last )
     : rows( make_vector( first, last ) )
-  { table.resize( rows.size() ); }
+  { init_table(); }
 
   // As above but use factor out some part-end.
   template < class InputIterator >
@@ -260,6 +264,25 @@ public:
     : pends( partends ), postgroup( postgroup )
   { init( make_vector( first, last ) ); }
 
+  // As above, but the table is read from cache_file if a table was 
+  // saved there from the same rows and groups.  This includes any 
+  // columns that had been computed when it was saved.  Where possible 
+  // the file is memory-mapped, so that processes using the same cache 
+  // file share the table.
+  template < class InputIterator >
+  multtab( InputIterator first, InputIterator last, const group& partends, 
+           const group& postgroup, const string& cache_file )
+    : pends( partends ), postgroup( postgroup )
+  { init( make_vector( first, last ), cache_file, false ); }
+
+  // Save a table made by the constructor above to a file, for use by
+  // later runs.  Returns false if the file could not be written.
+  bool save( const string& filename ) const;
+
+  // Whether the table was read from a cache file, and no columns have 
+  // been added to it since.
+  bool cached() const { return from_cache; }
+
   typedef RINGING_DETAILS_PREFIX multtab_row_t      row_t;
   typedef RINGING_DETAILS_PREFIX multtab_post_col_t post_col_t;
   typedef RINGING_DETAILS_PREFIX multtab_pre_col_t  pre_col_t;
@@ -280,7 +303,7 @@ public:
   row   find( const row_t &r ) const;
 
   // The number of rows in the table
-  size_t size() const { return table.size(); }
+  size_t size() const { return rows.size(); }
 
   const group& partends() const { return pends; }
   size_t group_size() const { return pends.size(); }
@@ -298,6 +321,15 @@ public:
   RINGING_DETAILS_PREFIX operator*( RINGING_DETAILS_PREFIX sqmulttab_row_t l, 
                                     RINGING_DETAILS_PREFIX sqmulttab_row_t r );
 
+protected:
+  // For sqmulttab: the table is read from or saved to cache_file
+  enum square_tag { square };
+
+  template < class InputIterator >
+  multtab( InputIterator first, InputIterator last, 
+           const string& cache_file, square_tag )
+  { init( make_vector( first, last ), cache_file, true ); }
+
 private:
   // A helper to do what the templated constructor of vector does
   // (we can't use that directly because MSVC doesn't have it).
@@ -315,15 +347,57 @@ private:
   row make_post_representative( const row &r ) const;
 
   void init( const vector< row > &r );
+  void init( const vector< row > &r, const string& cache_file, 
+             bool is_square );
+  void init_table();
+
+  // Reading from a cache file
+  class mapping;
+  bool load( const string& filename );
+  void set_data();
+
+  // Rebuild the hash index after rows has changed, and look up a row
+  // in it, returning size() if the row is not present.
+  void index_rows();
+  size_t find_index( const row &r ) const;
+  size_t column_entry( const row &r ) const;
+  void add_column( vector< size_t > const& col );
+
+  size_t lookup( size_t r, size_t c ) const
+  { 
+    return narrow ? data16[ r * stride + c ] 
+                  : data32[ r * stride + c ]; 
+  }
 
   // Data members
   //
-  // See CVS on 2010-02-06 for an implementation using single indirection
-  // (i.e. with a vector<row_t> and indexing via table[c*N+r] instead of 
-  // table[r][c]).  The version with a single indirection turned out to
-  // perform marginally worse than this version with a double indirection.
-  vector< vector< row_t > > table;
+  // The table is stored in a single vector with the entries for each 
+  // row adjacent, so that multiplying a row by each of the calls and 
+  // false lead heads in turn touches only one or two cache lines.  
+  // Space is left for stride columns on each row, and the table is 
+  // relaid when more are needed.  Entries are stored in 16 bits where 
+  // there are few enough rows, and in 32 bits otherwise.
+  //
+  // See CVS on 2010-02-06 for an implementation using a single vector
+  // of row_t indexed via table[c*N+r], which performed marginally worse
+  // than the vector of vectors that this replaced.  Storing by column 
+  // with narrow entries is also slower than storing by row.
+  bool narrow;
+  size_t stride;
+  vector< unsigned short > table16;
+  vector< unsigned int > table32;
+  // The entries: the contents of table16 or table32, or of a cache 
+  // file mapped into memory.
+  unsigned short const* data16;
+  unsigned int const* data32;
+  shared_pointer< mapping > mapped;
+  RINGING_ULLONG key;             // Identifies the table in a cache file
+  bool from_cache;
   vector< row > rows;
+  // An open-addressed hash table with linear probing giving the 
+  // position of each row in rows.  Each slot is one more than the 
+  // index into rows, or 0 if empty.
+  vector< size_t > slots;
   group pends, postgroup;
   enum pre_or_post { pre_mult, post_mult };
   vector< pair< row, pre_or_post > > cols;
@@ -338,6 +412,14 @@ public:
     : multtab( first, last )
   { sqinit(); }
 
+  // As above, but read the table from cache_file if it has been saved 
+  // there, and otherwise build it and save it there.
+  template < class InputIterator >
+  sqmulttab( InputIterator first, InputIterator last, 
+             const string& cache_file )
+    : multtab( first, last, cache_file, square )
+  { if ( !cached() ) { sqinit(); save( cache_file ); } }
+
   typedef RINGING_DETAILS_PREFIX sqmulttab_row_t row_t;
 
   typedef row_t post_col_t;
@@ -357,14 +439,13 @@ RINGING_START_DETAILS_NAMESPACE
 
 // Operators to do optimised multiplication of rows:
 inline multtab_row_t operator*( multtab_row_t r, multtab_post_col_t c )
-{ return c.t->table[ r.index() ][ c.n ]; }
+{ return multtab_row_t::from_index( c.t->lookup( r.index(), c.n ) ); }
 
 inline multtab_row_t operator*( multtab_pre_col_t c, multtab_row_t r )
-{ return c.t->table[ r.index() ][ c.n ]; }
+{ return multtab_row_t::from_index( c.t->lookup( r.index(), c.n ) ); }
 
 inline sqmulttab_row_t operator*( sqmulttab_row_t l, sqmulttab_row_t r )
-{ return sqmulttab_row_t
-           ( l.t->table[ l.index() ][ r.index() ].index(), l.t ); }
+{ return sqmulttab_row_t( l.t->lookup( l.index(), r.index() ), l.t ); }
 
 // Conversion operator
 inline sqmulttab_row_t::operator multtab_post_col_t() const
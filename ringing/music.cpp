@@ -36,6 +36,13 @@
 #include <cstdio>
 #include <cstring>
 #endif   
+#if RINGING_OLD_INCLUDES
+#include <algo.h>
+#include <vector.h>
+#else
+#include <algorithm>
+#include <vector>
+#endif
 
 RINGING_START_NAMESPACE
 
@@ -60,6 +67,8 @@ public:
   music_node* clone() const { return new music_node(*this); }
 
 private:
+  friend class music_table;
+
   BellNodeMap subnodes;
   vector<unsigned int>  detailsmatch;
   unsigned int bells;
@@ -67,6 +76,148 @@ private:
   void add_to_subtree(unsigned int place, const music_details &md, unsigned int i, unsigned int key, unsigned int pos, bool process_star);
 };
 
+// The music_node tree is walked for each bell of each row, following 
+// both the '?' branch and that bell's branch at each node, so it can be
+// in several nodes at once.  Because every node is at a fixed position,
+// the set of nodes that a row has reached after each bell can be 
+// precomputed.  This class numbers those sets and tabulates them, so 
+// matching a row just takes one table lookup per bell.
+class music_table
+{
+public:
+  music_table( music_node const& top, unsigned int bells );
+
+  // A table would be too large (or there are no bells); use the tree.
+  bool empty() const { return next.empty(); }
+  unsigned int bells() const { return b; }
+
+  bool match( row const& r, vector<music_details>& results, 
+              EStroke stroke ) const;
+
+  // Helper function to work with cloning_pointer.
+  music_table* clone() const { return new music_table(*this); }
+
+private:
+  typedef vector< music_node const* > node_set;
+
+  // Give up if there are more than this many sets of nodes
+  enum { max_states = 1 << 16 };
+
+  unsigned int state( node_set const& s, unsigned int pos );
+  void add_matches( music_node const* n, bool below );
+
+  unsigned int b;
+
+  // State 0 matches nothing; the initial state is 1.  The state after
+  // bell x from state s is next[ s * b + x ].  Entering state s matches
+  // the patterns out[ out_begin[s] ] to out[ out_begin[s+1]-1 ].
+  vector<unsigned int> next;
+  vector<unsigned int> out_begin, out;
+
+  // Only used while building the table
+  map< node_set, unsigned int > states;
+  vector< pair<node_set, unsigned int> > pending;
+};
+
+music_table::music_table( music_node const& top, unsigned int bells )
+  : b( bells )
+{
+  if ( b == 0 ) return;
+
+  out_begin.push_back(0);
+  out_begin.push_back(0);  // State 0 matches nothing
+
+  state( node_set( 1, &top ), 0 );
+
+  for ( size_t i = 0; i < pending.size(); ++i )
+    {
+      node_set const s = pending[i].first;
+      unsigned int const pos = pending[i].second;
+      if ( pos == b ) continue;
+
+      for ( unsigned int x = 0; x < b; ++x ) 
+        {
+          node_set t;
+          for ( node_set::const_iterator j = s.begin(), e = s.end(); 
+                j != e; ++j ) 
+            {
+              music_node::BellNodeMap::const_iterator k 
+                = (*j)->subnodes.find(0);
+              if ( k != (*j)->subnodes.end() ) t.push_back( k->second.get() );
+              k = (*j)->subnodes.find(x+1);
+              if ( k != (*j)->subnodes.end() ) t.push_back( k->second.get() );
+            }
+
+          unsigned int const n = state( t, pos+1 );
+          if ( n == unsigned(-1) ) {
+            // Too big; it will not be used.
+            next.clear();  out_begin.clear();  out.clear();
+            break;
+          }
+          next[ (i+1) * b + x ] = n;
+        }
+
+      if ( next.empty() ) break;
+    }
+
+  map< node_set, unsigned int >().swap( states );
+  vector< pair<node_set, unsigned int> >().swap( pending );
+}
+
+unsigned int music_table::state( node_set const& s0, unsigned int pos )
+{
+  if ( s0.empty() ) return 0;
+
+  node_set s( s0 );  sort( s.begin(), s.end() );
+
+  map< node_set, unsigned int >::const_iterator i = states.find(s);
+  if ( i != states.end() ) return i->second;
+
+  if ( states.size() == max_states ) return unsigned(-1);
+
+  unsigned int const n = states.size() + 1;
+  states[s] = n;
+  pending.push_back( make_pair( s, pos ) );
+  next.resize( (n + 1) * b );
+
+  // Once the row is finished, the tree would still follow '?' branches 
+  // to the end.
+  for ( node_set::const_iterator j = s.begin(), e = s.end(); j != e; ++j )
+    add_matches( *j, pos == b );
+  out_begin.push_back( out.size() );
+
+  return n;
+}
+
+void music_table::add_matches( music_node const* n, bool below )
+{
+  copy( n->detailsmatch.begin(), n->detailsmatch.end(), 
+        back_inserter(out) );
+
+  if ( below ) {
+    music_node::BellNodeMap::const_iterator k = n->subnodes.find(0);
+    if ( k != n->subnodes.end() ) add_matches( k->second.get(), true );
+  }
+}
+
+bool music_table::match( row const& r, vector<music_details>& results, 
+                         EStroke stroke ) const
+{
+  unsigned int s = 1, found = out_begin[2] - out_begin[1];
+  for ( unsigned int i = out_begin[1]; i < out_begin[2]; ++i )
+    results[ out[i] ].increment(stroke);
+
+  for ( unsigned int pos = 0; s && pos < b; ++pos ) 
+    {
+      s = next[ s * b + r[pos] ];
+      for ( unsigned int i = out_begin[s], e = out_begin[s+1]; i < e; ++i )
+        results[ out[i] ].increment(stroke);
+      found += out_begin[s+1] - out_begin[s];
+    }
+
+  return found;
+}
+
 unsigned int count_bells(const string &s)
 {
   unsigned int total = 0;
@@ -377,6 +528,7 @@ void music::push_back(const music_details &md)
 
   info.push_back(md);
   top_node->add(md, 0, info.size() - 1, 0);
+  table.reset();
 }
 
 music::iterator music::begin()
@@ -412,6 +564,7 @@ void music::set_bells(unsigned int new_b)
 
     top_node->set_bells(new_b);
     b = new_b;
+    table.reset();
   }
 }
 
@@ -427,7 +580,15 @@ void music::reset_music(void)
 // and increments or changes the appriopriate variable.
 bool music::process_row(const row &r, bool back)
 {
-  return top_node->match(r, 0, info, back ? eBackstroke : eHandstroke);
+  EStroke const stroke = back ? eBackstroke : eHandstroke;
+
+  if ( !table ) 
+    table.reset( new music_table( *top_node, b ) );
+
+  if ( !table->empty() && unsigned( r.bells() ) == table->bells() )
+    return table->match(r, info, stroke);
+  else
+    return top_node->match(r, 0, info, stroke);
 }
 
 // Return the total score for all items
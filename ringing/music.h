@@ -61,6 +61,7 @@ RINGING_USING_STD
 
 class music;
 class music_node;
+class music_table;
 
 enum EStroke
 {
@@ -100,6 +101,7 @@ public:
 
   friend class music;
   friend class music_node;
+  friend class music_table;
 
   typedef row_wildcard::invalid_pattern invalid_regex;
 
@@ -176,6 +178,8 @@ private:
   mdvector info;
   // The tree containing the structure for matching rows
   cloning_pointer<music_node> top_node;
+  // The same tree compiled into a lookup table; built when first needed
+  cloning_pointer<music_table> table;
 
   unsigned int b;
 };
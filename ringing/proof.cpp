@@ -27,55 +27,358 @@
 #endif
 
 #include <stdexcept>
+#if RINGING_OLD_C_INCLUDES
+#include <assert.h>
+#else
+#include <cassert>
+#endif
 
 #include <ringing/proof.h>
+#include <ringing/extent.h>
+#include <ringing/mathutils.h>
 #include <ringing/iteratorutils.h>
 
 RINGING_USING_STD
 
 RINGING_START_NAMESPACE
 
-size_t prover::count_row( const row& r ) const
+// The interface to the storage used by a single prover.  Each 
+// implementation records the line number of each row so that the
+// lines of duplicate rows can be reported in the failinfo.
+class prover::store 
 {
-  size_t n(0);
+public:
+  virtual ~store() {}
+  virtual store* clone() const = 0;
+
+  // The number of times r occurs
+  virtual size_t count( row const& r ) const = 0;
+
+  // Add r as line number lineno, returning the number of times it 
+  // now occurs
+  virtual size_t insert( row const& r, int lineno ) = 0;
+
+  // Remove the most recent occurrence of r, which must be present
+  virtual void erase( row const& r ) = 0;
 
-  for ( prover const* p = this; p; p = p->chain.get() ) {
-    pair< mmap::const_iterator, mmap::const_iterator > rng 
-      = p->m.equal_range(r);
-    n += distance( rng.first, rng.second );
+  // Append the line numbers on which r occurs to lines, in order
+  virtual void lines( row const& r, list<int>& lines ) const = 0;
+
+  // The total number of rows
+  virtual size_t size() const = 0;
+};
+
+RINGING_START_ANON_NAMESPACE
+
+class multimap_store : public prover::store
+{
+public:
+  virtual store* clone() const { return new multimap_store(*this); }
+
+  virtual size_t count( row const& r ) const { return m.count(r); }
+  virtual size_t size() const { return m.size(); }
+
+  virtual size_t insert( row const& r, int lineno ) 
+  {
+    // This is quite complicated to avoid doing more than one
+    // O( ln N ) operation on the multimap.  The equal_range function call
+    // will be O( ln N ); the insert function ought to be O(1) because a 
+    // sensible hint is supplied (although the C++ standard doesn't require
+    // the hint to be used).  The number of identical elements is also 
+    // calculated from the range, rather than doing a O( ln N ) call to 
+    // multimap::count.
+    range rng( m.equal_range(r) );
+    size_t n = 1 + distance( rng.first, rng.second );
+    m.insert( rng.first == m.begin() ? m.begin() : prior( rng.first ),
+              mmap::value_type( r, lineno ) );
+    return n;
   }
 
-  return n;
+  virtual void erase( row const& r )
+  {
+    // Not necessarily the last of the equivalent keys: see lines() below.
+    range rng( m.equal_range(r) );
+    mmap::iterator latest = rng.first;
+    for ( mmap::iterator i = rng.first; i != rng.second; ++i )
+      if ( i->second > latest->second ) latest = i;
+    m.erase( latest );
+  }
+
+  virtual void lines( row const& r, list<int>& l ) const
+  {
+    // The order of equivalent keys in the multimap depends on how the
+    // implementation has treated the insertion hint.
+    list<int> tmp;
+    for ( mmap::const_iterator i = m.lower_bound(r), e = m.end(); 
+          i != e && i->first == r; ++i )
+      tmp.push_back( i->second );
+    tmp.sort();
+    l.splice( l.end(), tmp );
+  }
+
+private:
+  typedef multimap<row, int> mmap;
+  typedef pair< mmap::iterator, mmap::iterator > range;
+  mmap m;
+};
+
+// An open-addressed hash table of the distinct rows, with linear
+// probing.  Rows whose count drops to zero are left in the table 
+// until it is next resized, as most uses of remove_row will shortly 
+// add the same row again.
+class hash_store : public prover::store
+{
+public:
+  hash_store() : slots(16, 0), total(0) {}
+
+  virtual store* clone() const { return new hash_store(*this); }
+
+  virtual size_t count( row const& r ) const 
+  { 
+    int i = slots[ find( r, r.hash() ) ];
+    return i ? entries[i-1].count : 0;
+  }
+
+  virtual size_t size() const { return total; }
+
+  virtual size_t insert( row const& r, int lineno ) 
+  {
+    size_t const h = r.hash();
+    size_t s = find( r, h );
+    if ( !slots[s] ) {
+      if ( 2 * (entries.size() + 1) > slots.size() ) {
+        rehash();
+        s = find( r, h );
+      }
+      entries.push_back( entry(r, h) );
+      slots[s] = entries.size();
+    }
+
+    entry& e = entries[ slots[s]-1 ];
+    history.push_back( make_pair( slots[s]-1, lineno ) );
+    ++total;
+    return ++e.count;
+  }
+
+  virtual void erase( row const& r )
+  {
+    int const i = slots[ find( r, r.hash() ) ] - 1;
+    assert( i != -1 && entries[i].count );
+    --entries[i].count; --total;
+
+    // Almost always the last row is the one being removed
+    history_t::iterator j = history.end();
+    while ( (--j)->first != i ) 
+      ;
+    history.erase(j);
+  }
+
+  virtual void lines( row const& r, list<int>& l ) const
+  {
+    int const i = slots[ find( r, r.hash() ) ] - 1;
+    if ( i != -1 ) 
+      for ( history_t::const_iterator j = history.begin(), e = history.end();
+            j != e; ++j )
+        if ( j->first == i ) 
+          l.push_back( j->second );
+  }
+
+private:
+  // Return the index of the slot containing r, or of the empty slot
+  // where it should be inserted.
+  size_t find( row const& r, size_t h ) const 
+  {
+    size_t const mask = slots.size() - 1;
+    size_t i = h & mask;
+    while ( slots[i] ) {
+      entry const& e = entries[ slots[i]-1 ];
+      if ( e.hash == h && e.r == r ) break;
+      i = (i+1) & mask;
+    }
+    return i;
+  }
+
+  // Discard rows that are no longer present and, if necessary, increase 
+  // the number of slots.
+  void rehash()
+  {
+    vector<int> renumber( entries.size(), -1 );
+    vector<entry> live;
+    for ( size_t i = 0; i < entries.size(); ++i )
+      if ( entries[i].count ) {
+        renumber[i] = live.size();
+        live.push_back( entries[i] );
+      }
+    for ( history_t::iterator i = history.begin(); i != history.end(); ++i )
+      i->first = renumber[ i->first ];
+    entries.swap(live);
+
+    size_t n = slots.size();
+    while ( 4 * (entries.size() + 1) > n ) n *= 2;
+    slots.assign( n, 0 );
+    for ( size_t i = 0; i < entries.size(); ++i )
+      slots[ find( entries[i].r, entries[i].hash ) ] = i+1;
+  }
+
+  struct entry {
+    entry( row const& r, size_t hash ) : r(r), hash(hash), count(0) {}
+    row r;
+    size_t hash;
+    size_t count;
+  };
+
+  typedef vector< pair<int, int> > history_t;
+
+  vector<entry> entries;
+  vector<int> slots;      // One more than the index into entries, or 0
+  history_t history;      // The entry index and line number of each row
+  size_t total;
+};
+
+// A bitset with one bit for each row of the extent, indexed by
+// position_in_extent.  This only records whether a row is present: 
+// repeated rows (and any rows on a different number of bells) are 
+// additionally kept in a hash table, which will be empty in the 
+// common case of a true touch.
+class extent_store : public prover::store
+{
+public:
+  explicit extent_store( int bells ) 
+    : bells(bells), bits( (factorial(bells) + word_bits - 1) / word_bits ) 
+  {}
+
+  virtual store* clone() const { return new extent_store(*this); }
+
+  virtual size_t count( row const& r ) const 
+  { 
+    return (r.bells() == bells && test( index(r) )) + extra.count(r);
+  }
+
+  virtual size_t size() const { return history.size() + extra.size(); }
+
+  virtual size_t insert( row const& r, int lineno ) 
+  {
+    if ( r.bells() == bells ) {
+      size_t const i = index(r);
+      if ( !test(i) ) {
+        bits[ i / word_bits ] |= 1ul << i % word_bits;
+        history.push_back( make_pair(i, lineno) );
+        return 1;
+      }
+      return 1 + extra.insert( r, lineno );
+    }
+    return extra.insert( r, lineno );
+  }
+
+  virtual void erase( row const& r )
+  {
+    // Any later occurrences will be in extra
+    if ( extra.count(r) ) 
+      extra.erase(r);
+    else {
+      size_t const i = index(r);
+      bits[ i / word_bits ] &= ~(1ul << i % word_bits);
+
+      history_t::iterator j = history.end();
+      while ( (--j)->first != i ) 
+        ;
+      history.erase(j);
+    }
+  }
+
+  virtual void lines( row const& r, list<int>& l ) const
+  {
+    if ( r.bells() == bells ) {
+      size_t const i = index(r);
+      if ( test(i) ) 
+        for ( history_t::const_iterator j = history.begin(), 
+                e = history.end(); j != e; ++j )
+          if ( j->first == i ) {
+            l.push_back( j->second );
+            break;
+          }
+    }
+    extra.lines( r, l );
+  }
+
+private:
+  enum { word_bits = sizeof(unsigned long) * CHAR_BIT };
+
+  size_t index( row const& r ) const { return position_in_extent( r ); }
+  bool test( size_t i ) const 
+    { return bits[ i / word_bits ] & 1ul << i % word_bits; }
+
+  typedef vector< pair<size_t, int> > history_t;
+
+  int bells;
+  vector<unsigned long> bits;
+  history_t history;    // The index and line of each row in bits
+  hash_store extra;
+};
+
+RINGING_END_ANON_NAMESPACE
+
+prover::prover( int max_occurs, storage_type st )
+  : st(st), max_occurs(max_occurs), lineno(0), falsec(0u), dups(0u), 
+    fi(NULL)
+{
 }
 
-// Returns false if the touch is false
-bool prover::add_row( const row &r )
+prover::prover( failinfo& fi, int max_occurs, storage_type st )
+  : st(st), max_occurs(max_occurs), lineno(0), falsec(0u), dups(0u), 
+    fi(&fi)
 {
-  // This function is quite complicated to avoid doing more than one
-  // O( ln N ) operation on each multimap.  The equal_range function call
-  // will be O( ln N ); the insert function ought to be O(1) because a 
-  // sensible hint is supplied (although the C++ standard doesn't require
-  // the hint to be used).  The number of identical elements is also 
-  // calculated from the range, rather than doing a O( ln N ) call to 
-  // multimap::count.
+}
 
-  typedef pair< mmap::iterator, mmap::iterator > range;
-  list<range> ranges;
+prover::store& prover::get_store( row const& r )
+{
+  if (!m) {
+    store* s = NULL;
+    switch (st) {
+      case multimap_storage: 
+        s = new multimap_store; 
+        break;
+      case automatic_storage: 
+        if ( r.bells() > max_extent_bells ) {
+          s = new hash_store;
+          break;
+        }
+        // Fall through
+      case extent_storage:
+        s = new extent_store( r.bells() ); 
+        break;
+      case hash_storage:
+        s = new hash_store;
+        break;
+    }
+    m = cloning_pointer<store>( s, delete_helper<store>::fn, 
+                                clone_helper<store>::fn );
+  }
+  return *m;
+}
 
-  for ( prover* p = this; p; p = p->chain.get() ) 
-    ranges.push_front( p->m.equal_range(r) );
+size_t prover::size() const
+{
+  return m ? m->size() : 0;
+}
+
+size_t prover::count_row( const row& r ) const
+{
+  size_t n(0);
 
-  // effecively m.count(r)
-  size_t n(1);
-  for ( list<range>::const_iterator ri = ranges.begin(), re = ranges.end(); 
-	ri != re; ++ri ) 
-    n += distance( ri->first, ri->second );
+  for ( prover const* p = this; p; p = p->chain.get() )
+    if ( p->m ) n += p->m->count(r);
 
-  range const& rng = ranges.back();
+  return n;
+}
 
-  mmap::iterator i( m.insert( rng.first == m.begin() ? m.begin() 
-			                             : prior( rng.first ),
-			      mmap::value_type( r, ++lineno ) ) );
+// Returns false if the touch is false
+bool prover::add_row( const row &r )
+{
+  // effecively count_row(r) + 1
+  size_t n = get_store(r).insert( r, ++lineno );
+  for ( prover const* p = chain.get(); p; p = p->chain.get() )
+    if ( p->m ) n += p->m->count(r);
 
   if ( n > 1 )
     ++dups; 
@@ -85,33 +388,16 @@ bool prover::add_row( const row &r )
       falsec++;
       if ( fi )
 	{
-
 	  for ( failinfo::iterator j = fi->begin(), e = fi->end(); j != e; ++j)
 	    if ( j->_row == r )
 	      {
-		j->_lines.push_back( i->second );
+		j->_lines.push_back( lineno );
 		return false;
 	      }
 
 	  linedetail l;
-
-	  // The C++ standard doesn't make any guarantee about where i
-	  // is in relation to rng.first and rng.second -- it may fall in
-	  // the range [rng.first, rng.second), but equally, it might get 
-	  // inserted immediately before rng.first.  If we don't detect i 
-	  // in this range, we explicitly add it by hand afterwards.
 	  l._row = r;
-	  bool added_i = false;
-	  {
-	    for ( mmap::iterator j = rng.first; j != rng.second; ++j )
-	      {
-		if ( j == i ) added_i = true;
-		l._lines.push_back( j->second );
-	      }
-	  }
-	  if (!added_i) 
-	    l._lines.push_back( i->second );
-
+	  m->lines( r, l._lines );
 	  fi->push_back( l );
 	  return false;
 	}
@@ -122,27 +408,16 @@ bool prover::add_row( const row &r )
 
 void prover::remove_row( const row& r )
 {
-  // As above.  TODO:  Refactor
-  typedef pair< mmap::iterator, mmap::iterator > range;
-  list<range> ranges;
-
-  for ( prover* p = this; p; p = p->chain.get() ) 
-    ranges.push_front( p->m.equal_range(r) );
-
-  // effecively m.count(r)
-  size_t n(0);  // Note this is not 1 as in add_row
-  for ( list<range>::const_iterator ri = ranges.begin(), re = ranges.end(); 
-	ri != re; ++ri ) 
-    n += distance( ri->first, ri->second );
+  size_t const here = m ? m->count(r) : 0;
+  size_t const n = count_row(r);  // Note this is not 1 as in add_row
 
-  range const& rng = ranges.back();
   if ( n == 0 )
     throw logic_error( "Row does not exist to be removed" );
-  if ( rng.first == rng.second ) 
+  if ( here == 0 ) 
     throw logic_error( "Row does not exist at proof head to be removed" );
 
   --lineno;
-  m.erase( prior( rng.second ) );
+  m->erase(r);
 
   if ( n > 1 )
     --dups;
@@ -173,6 +448,9 @@ prover::create_branch( shared_pointer<prover> const& chain )
   p->dups       = chain->dups;
   p->fi         = chain->fi;
   // NB do not copy chain->m.
+  // Branches usually contain few rows, so a bitset of the whole extent
+  // is a waste: use a hash table instead.
+  p->st = chain->st == multimap_storage ? multimap_storage : hash_storage;
   return p;
 }
 
@@ -70,17 +70,32 @@ class RINGING_API prover
 public:
   typedef list<linedetail> failinfo;
 
+  // How the rows are stored.  The multimap is the original 
+  // implementation; the hash table is considerably faster.  The extent
+  // storage is a bitset indexed by position_in_extent, which is faster
+  // still, but uses (bells)!/8 bytes and so is only suitable for small 
+  // stages; automatic storage selects it on up to max_extent_bells.
+  // Rows are all expected to be on the same number of bells (the number
+  // in the first row added) when extent storage is used, though other 
+  // rows are handled correctly.
+  enum storage_type {
+    multimap_storage,
+    hash_storage,
+    extent_storage,
+    automatic_storage
+  };
+
+  enum { max_extent_bells = 10 };
+
   // max_occurs is the number of times a row is permitted to occur
   // in the touch before it is considered false.
-  explicit prover( int max_occurs = 1 )
-    : max_occurs(max_occurs), lineno(0), falsec(0u), dups(0u), fi(NULL)
-  {}
+  explicit prover( int max_occurs = 1, 
+                   storage_type st = multimap_storage );
 
   // fi is a structure into which information about duplicate lines 
   // are inserted.
-  explicit prover( failinfo &fi, int max_occurs = 1 )
-    : max_occurs(max_occurs), lineno(0), falsec(0u), dups(0u), fi(&fi)
-  {}
+  explicit prover( failinfo &fi, int max_occurs = 1, 
+                   storage_type st = multimap_storage );
 
   // Adds a row to the touch, and returns true if the touch (so far) 
   // contains no rows more than max_occurs times.  Inserts rows present 
@@ -93,7 +108,7 @@ public:
   size_t count_row( const row& r ) const;
 
   // The length of the touch
-  size_t size() const { return m.size(); }
+  size_t size() const;
 
   size_t duplicates() const { return dups; }
 
@@ -108,13 +123,19 @@ public:
   static shared_pointer<prover> 
   create_branch( shared_pointer<prover> const& chain );
 
+  // The interface to the different storage types.  Defined in proof.cpp.
+  class store;
+
 private:
+  // The store is created when the first row is added
+  store& get_store( row const& r );
+
   shared_pointer<prover> chain;
-  typedef multimap<row, int> mmap;
+  storage_type st;
   int max_occurs;
   int lineno;
   size_t falsec, dups;
-  mmap m;
+  cloning_pointer<store> m;
   failinfo *fi;
 };
 
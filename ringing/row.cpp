@@ -53,6 +53,21 @@
 #include <ringing/mathutils.h>
 #include <ringing/istream_impl.h>
 
+// On x86, transposing rows of up to 16 bells is a single SSSE3 byte 
+// shuffle.  The kernel is compiled with a function-specific target so 
+// that the library as a whole does not require SSSE3, and is only used
+// if the CPU is found to support it at run time.
+#if !defined(RINGING_USE_SSSE3) && RINGING_BELL_BITS == CHAR_BIT      \
+    && ( defined(__x86_64__) || defined(__i386__) )                   \
+    && ( __GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 9 \
+        || defined(__clang__) )
+#define RINGING_USE_SSSE3 1
+#endif
+
+#if RINGING_USE_SSSE3
+#include <tmmintrin.h>
+#endif
+
 #if RINGING_BACKWARDS_COMPATIBLE(0,3,0) && defined(_MSC_VER)
 // Microsoft have deprecated strcpy in favour of a non-standard
 // extension, strcpy_s.  4996 is the warning about it being deprecated.
@@ -69,48 +84,100 @@ RINGING_START_NAMESPACE
 
 // Return rounds on n bells
 row::row(int num)
-  : data(num)
+  : n(0)
 {
+  reset(num);
   rounds();
 }
  
 // Construct a row from a string
 row::row(const char *s)
+  : n(0)
 {
+  vector<bell> data;
   data.reserve(strlen(s));
   while (*s)
     data.push_back( bell::read_extended(s, &s) );
+  assign( data.empty() ? NULL : &data[0], data.size() );
   validate();
 }
 
 row::row(const string &str)
+  : n(0)
 {
+  vector<bell> data;
   data.reserve(str.size());
   char const* s = str.c_str();
   while (*s)
     data.push_back( bell::read_extended(s, &s) );
+  assign( data.empty() ? NULL : &data[0], data.size() );
+  validate();
+}
+
+row::row(vector<bell> const& d)
+  : n(0)
+{
+  assign( d.empty() ? NULL : &d[0], d.size() );
   validate();
 }
 
+row::row(row const& r)
+  : n(0)
+{
+  if (r.n > inline_bells) 
+    assign( r.u.ptr, r.n );
+  else {
+    u = r.u; n = r.n;
+  }
+}
+
+row& row::operator=(row const& r)
+{
+  if (r.n > inline_bells) 
+    assign( r.u.ptr, r.n );
+  else {
+    if (n > inline_bells) delete[] u.ptr;
+    u = r.u; n = r.n;
+  }
+  return *this;
+}
+
+void row::reset(int num)
+{
+  if (num == n) return;
+  if (n > inline_bells) delete[] u.ptr;
+  n = 0;
+  if (num > inline_bells) u.ptr = new bell[num];
+  n = num;
+}
+
+void row::assign(bell const* b, int num)
+{
+  reset(num);
+  copy( b, b + num, get() );
+}
+
+void row::swap(vector<bell>& other)
+{
+  vector<bell> old( begin(), end() );
+  row(other).swap(*this); 
+  other.swap(old);
+}
+
 void row::validate() const
 {
 #if RINGING_USE_EXCEPTIONS
+  bell const* data = get();
   vector<bool> found(bells());
   for(int i=0; i<bells(); ++i) found[i] = false;
   for(int i=0; i<bells(); ++i) 
-    if (data[i] < 0 || data[i] >= (int) data.size() || found[data[i]])
+    if (data[i] < 0 || data[i] >= n || found[data[i]])
       throw invalid(print());
     else
       found[data[i]] = true;
 #endif
 }
 
-row::row(vector<bell> const& d)
-  : data(d)
-{
-  validate();
-}
-
 row::invalid::invalid()
   : invalid_argument("The row supplied was invalid")
 {}
@@ -131,19 +198,54 @@ row& row::operator=(const string &s)
   return *this;
 }
 
+#if RINGING_USE_SSSE3
+RINGING_START_ANON_NAMESPACE
+
+bool detect_ssse3()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3");
+}
+
+// This is zero-initialised before any dynamic initialisation, so rows 
+// transposed during static initialisation use the portable code.
+bool const have_ssse3 = detect_ssse3();
+
+__attribute__((target("ssse3")))
+void transpose_ssse3( bell* p, bell const* a, bell const* b )
+{
+  // Both a and b point to at least 16 bytes of a row's internal buffer,
+  // though only the bytes that are part of the row are significant.
+  __m128i x = _mm_loadu_si128( reinterpret_cast<__m128i const*>(a) );
+  __m128i y = _mm_loadu_si128( reinterpret_cast<__m128i const*>(b) );
+  _mm_storeu_si128( reinterpret_cast<__m128i*>(p), _mm_shuffle_epi8(x, y) );
+}
+
+RINGING_END_ANON_NAMESPACE
+#endif
+
 // Transpose one row by another
 row row::operator*(const row& r) const
 {
   int m = (bells() < r.bells()) ? r.bells() : bells();
-  row product(m);
+  row product; product.reset(m);
+  bell const *a = get(), *b = r.get();
+  bell *p = product.get();
+#if RINGING_USE_SSSE3
+  if (have_ssse3 && n == r.n && n <= 16 && inline_bells >= 16) {
+    transpose_ssse3( p, a, b );
+    return product;
+  }
+#endif
   int i;
-  for(i = 0; i < r.bells(); i++)
-    if(r.data[i] < bells())
-      product.data[i] = data[r.data[i]];
-    else
-      product.data[i] = r.data[i];
+  if (r.bells() <= bells())
+    for(i = 0; i < r.bells(); i++)
+      p[i] = a[b[i]];
+  else
+    for(i = 0; i < r.bells(); i++)
+      p[i] = b[i] < bells() ? a[b[i]] : b[i];
   for(;i < m; i++)
-    product.data[i] = data[i];
+    p[i] = a[i];
   return product;
 }
 
@@ -157,14 +259,16 @@ row& row::operator*=(const row& r)
 row row::operator/(const row& r) const
 {
   int m = (bells() < r.bells()) ? r.bells() : bells();
-  row quotient(m);
+  row quotient; quotient.reset(m);
+  bell const *a = get(), *b = r.get();
+  bell *q = quotient.get();
   int i;
   for(i = 0; i < bells() && i < r.bells(); i++)
-    quotient.data[r.data[i]] = data[i];
+    q[b[i]] = a[i];
   for(; i < bells(); i++)
-    quotient.data[i] = data[i];
+    q[i] = a[i];
   for(; i < r.bells(); i++)
-    quotient.data[r.data[i]] = i;
+    q[b[i]] = i;
   return quotient;
 }
 
@@ -177,24 +281,28 @@ row& row::operator/=(const row& r)
 // Find the inverse of a row (same as dividing rounds by it)
 row row::inverse(void) const
 {
-  if(data.empty())
+  if(n == 0)
     return row();
-  row result(bells());
-  for(int i = 0; i < bells(); i++)
-    result.data[data[i]] = i;
+  row result; result.reset(n);
+  bell const* a = get();
+  bell* p = result.get();
+  for(int i = 0; i < n; i++)
+    p[a[i]] = i;
   return result;
 }
 
 // Apply a change to a row
 row& operator*=(row& r, const change& c)
 {
-  while (r.bells() < c.bells())
-    r.data.push_back(r.bells());
+  if (r.bells() < c.bells())
+    r.resize(c.bells());
 
-  if (c.n != 0 && !r.data.empty())
+  if (c.n != 0 && r.n != 0) {
+    bell* data = r.get();
     for ( vector<bell>::const_iterator s = c.swaps.begin(), e = c.swaps.end(); 
           s != e && *s < (r.bells() - 1); ++s )
-      RINGING_PREFIX_STD swap( r.data[*s], r.data[*s + 1] );
+      RINGING_PREFIX_STD swap( data[*s], data[*s + 1] );
+  }
 
   return r;
 }
@@ -212,10 +320,8 @@ string row::print() const
   string s;
   s.reserve( bells() );
 
-  if(!data.empty())
-    for(vector<bell>::const_iterator i = data.begin(); 
-	i != data.end(); ++i)
-      s += i->to_char();
+  for(const_iterator i = begin(); i != end(); ++i)
+    s += i->to_char();
   return s;
 }
 
@@ -229,6 +335,7 @@ char *row::print(char *s) const
 // Set it to rounds
 row& row::rounds(void)
 {
+  bell* data = get();
   for(int i = 0; i < bells(); i++)
     data[i] = i;
   return *this;
@@ -239,6 +346,7 @@ row row::queens(const int n)
 {
   row r(n);
   if ( n <= 2 ) return r;
+  bell* data = r.get();
 
   int half = 0;
   if (n % 2 == 1)
@@ -247,10 +355,10 @@ row row::queens(const int n)
     half = n / 2;
   
   for (int i = 0; i <= half; i++)
-    r.data[i] = (i * 2);
+    data[i] = (i * 2);
   
   for (int i = 0; i < (n / 2); i++)
-    r.data[i + half] = (i * 2) + 1;
+    data[i + half] = (i * 2) + 1;
   
   return r;
 }
@@ -260,6 +368,7 @@ row row::kings(const int n)
 {
   row r(n);
   if ( n <= 2 ) return r;
+  bell* data = r.get();
 
   int half = 0;
   if (n % 2 == 1)
@@ -268,10 +377,10 @@ row row::kings(const int n)
     half = n / 2;
   
   for (int i = 0; i <= half; i++)
-    r.data[i] = (half * 2) - (i * 2) - 2;
+    data[i] = (half * 2) - (i * 2) - 2;
   
   for (int i = 0; i < (n / 2); i++)
-    r.data[i + half] = (i * 2) + 1;
+    data[i + half] = (i * 2) + 1;
 
   return r;
 }
@@ -280,13 +389,14 @@ row row::kings(const int n)
 row row::tittums(const int n)
 {
   row r(n);
+  bell* data = r.get();
   int j = 0;
 
   for (int i = 0; i < n; i += 2)
-    r.data[i] = j++;
+    data[i] = j++;
 
   for (int i = 1; i < n; i += 2)
-    r.data[i] = j++;
+    data[i] = j++;
 
   return r;
 }
@@ -295,8 +405,9 @@ row row::tittums(const int n)
 row row::reverse_rounds(const int n)
 {
   row r(n);
+  bell* data = r.get();
   for (int i = 0; i < n; i++)
-    r.data[i] = n - i - 1;
+    data[i] = n - i - 1;
     
   return r;
 }
@@ -329,7 +440,7 @@ row row::cyclic(int n, int h, int c)
   if ( h < n ) {
     c %= n-h;
     if (c < 0) c += n-h;
-    rotate( r.data.begin() + h, r.data.begin() + h + c, r.data.end() );
+    rotate( r.get() + h, r.get() + h + c, r.get() + n );
   }
   return r;
 }
@@ -337,7 +448,7 @@ row row::cyclic(int n, int h, int c)
 // Check whether it is rounds
 bool row::isrounds(void) const
 {
-  if(data.empty()) return 1;
+  bell const* data = get();
   for(int i = 0; i < bells(); i++)
     if(data[i] != i) return false;
   return true;
@@ -357,7 +468,8 @@ int row::ispblh(int h) const
 // Return which plain bob lead head it is
 int row::ispblh(void) const
 {
-  if(data.empty()) return 1;
+  if(n == 0) return 1;
+  bell const* data = get();
   int h;
   for(h = 0; h < bells() && data[h] == h; h++);
   if(h == 0) return 0;
@@ -374,7 +486,8 @@ string row::cycles() const
 			       // can temporarily exceed this before the
 			       // trailing ',' is removed.
 
-  if (data.empty()) return result;
+  if (n == 0) return result;
+  bell const* data = get();
   vector<bool> done(bells(), false);
 
   int i = 0;
@@ -405,7 +518,7 @@ char *row::cycles(char *result) const
 // Return the order of a row
 int row::order(void) const
 {
-  if(data.empty()) return 1;
+  if(n == 0) return 1;
   int o = 1;
 
   // We do this by expressing the row as disjoint cycles, then by taking the
@@ -444,17 +557,20 @@ size_t row::hash() const
   // We use 31 as the FNV prime because it is a Mersenne prime: the FNV 
   // algorithm requires a prime, and being of the form 2^n-1 means that the
   // compiler / processor microcode can optimise the multiplication to a 
-  // shift and subtract.
+  // shift and subtract.  On its own that leaves the low bits poorly 
+  // distributed, so the result is finished with hash_finish.
 
+  bell const* data = get();
   size_t h = bells();
-  for ( int i=0, n=bells(); i != n; ++i )
-    h = 31*h + data[i];
-  return h;
+  for ( int i=0; i != n; ++i )
+    h = hash_combine( h, data[i] );
+  return hash_finish(h);
 }
 
 int row::find(bell const& b) const
 {
-  for ( int i=0, n=bells(); i != n; ++i )
+  bell const* data = get();
+  for ( int i=0; i != n; ++i )
     if ( data[i] == b ) 
       return i;
 
@@ -483,14 +599,17 @@ row row::power( int n ) const
 
 void row::resize(int b)
 {
-  if ( b < data.size() ) {
-    vector<bell> tmp( data.begin(), data.begin() + b );
+  if ( b < n ) {
+    vector<bell> tmp( begin(), begin() + b );
     row(tmp).swap(*this);
   }
-  else {
-    data.reserve(b);
-    while ( data.size() < b )
-      data.push_back( data.size() );
+  else if ( b > n ) {
+    row tmp; tmp.reset(b);
+    bell* data = tmp.get();
+    copy( begin(), end(), data );
+    for ( int i = n; i < b; ++i )
+      data[i] = i;
+    swap(tmp);
   }
 }
 
@@ -38,11 +38,13 @@
 #include <vector.h>
 #include <stdexcept.h>
 #include <utility.h>
+#include <algo.h>
 #else
 #include <ostream>
 #include <vector>
 #include <stdexcept>
 #include <utility>
+#include <algorithm>
 #endif
 #if RINGING_OLD_C_INCLUDES
 #include <ctype.h>
@@ -72,27 +74,38 @@ RINGING_USING_STD
 
 class change;
 
+// The steps of the hash used by row::hash, for other hash tables to 
+// share.  Values are combined into a running hash, starting from any 
+// seed, and the hash is finished so that its low bits are well 
+// distributed, as an open-addressed table needs.
+inline size_t hash_combine( size_t h, size_t v ) { return 31*h + v; }
+
+inline size_t hash_finish( size_t h )
+{
+  h ^= h >> 16;  h *= 0x45d9f3bu;  h ^= h >> 16;
+  return h;
+}
+
 // row : This stores one row 
 class RINGING_API row {
-private:
-  vector<bell> data;	        // The actual row
-
 public:
-  row() {}
+  row() : n(0) {}
   explicit row(int num);	// Construct rounds on n bells
   row(const char *s);			// Construct a row from a string
   row(const string &s);			// Construct a row from a string
   explicit row(const vector<bell>& d);  // Construct from data
-  // Use default copy constructor and copy assignment
+  row(const row& r);
+ ~row() { if (n > inline_bells) delete[] u.ptr; }
 
+  row& operator=(const row& r);
   row& operator=(const char *s);	// Assign a string
   row& operator=(const string &s);	// Assign a string
   bool operator==(const row& r) const  // Compare
-    { return data == r.data; }
+    { return n == r.n && RINGING_PREFIX_STD equal(begin(), end(), r.begin()); }
   bool operator!=(const row& r) const
-    { return data != r.data; }
+    { return !(*this == r); }
   bell operator[](int i) const	// Return one particular bell (not an lvalue).
-    { return data[i]; }
+    { return get()[i]; }
   row operator*(const row& r) const; // Transpose one row by another
   row& operator*=(const row& r);
   row operator/(const row& r) const; // Inverse of transposition
@@ -103,7 +116,7 @@ public:
   row power(int n) const;       // Fidn the nth power of the row
 
   string print() const;		// Print the row into a string
-  int bells(void) const { return data.size(); } // How many bells?
+  int bells(void) const { return n; } // How many bells?
   row& rounds(void);		// Set it to rounds
 
   static row rounds(const int n) { return row(n); } // Return rounds on n bells
@@ -125,8 +138,10 @@ public:
   int order(void) const;	    // Return the order
   friend RINGING_API ostream& operator<<(ostream&, const row&);
   friend RINGING_API istream& operator>>(istream&, row&);
-  void swap(row &other) { data.swap(other.data); }
-  void swap(vector<bell>& other) { data.swap(other); validate(); }
+  void swap(row &other) { 
+    RINGING_PREFIX_STD swap(u, other.u); RINGING_PREFIX_STD swap(n, other.n); 
+  }
+  void swap(vector<bell>& other);
   size_t hash() const;
 
   int find(bell const& b) const;// Finds the bell
@@ -137,24 +152,47 @@ public:
   };
 
   // So that we can put rows in containers
-  bool operator<(const row& r) const { return data < r.data; }
-  bool operator>(const row& r) const { return data > r.data; }
-  bool operator<=(const row& r) const { return data <= r.data; }
-  bool operator>=(const row& r) const { return data >= r.data; }
+  bool operator<(const row& r) const { 
+    return RINGING_PREFIX_STD lexicographical_compare( begin(), end(), 
+                                                       r.begin(), r.end() ); 
+  }
+  bool operator>(const row& r) const { return r < *this; }
+  bool operator<=(const row& r) const { return !(r < *this); }
+  bool operator>=(const row& r) const { return !(*this < r); }
 
 #if RINGING_BACKWARDS_COMPATIBLE(0,3,0)
   char *print(char *s) const;   // This overload is deprecated.
   char *cycles(char *result) const; // This overload is deprecated.
 #endif
 
-  typedef vector<bell>::const_iterator const_iterator;
-  const_iterator begin() const { return data.begin(); }
-  const_iterator end() const { return data.end(); }
+  typedef bell const* const_iterator;
+  const_iterator begin() const { return get(); }
+  const_iterator end() const { return get() + n; }
 
   void resize(int b); // Truncate (or pad) to b bells or throw invalid
 
 private:
   void validate() const;
+  void assign(const bell* b, int num);
+
+  // Rows on up to inline_bells bells are stored in the object itself,
+  // as most rows are short-lived temporaries and a heap allocation
+  // would dominate the cost of making them.  Longer rows use the heap.
+  enum { inline_bells = 24 / sizeof(bell) };
+
+  bell* get() 
+    { return n > inline_bells ? u.ptr : reinterpret_cast<bell*>(u.buf); }
+  bell const* get() const
+    { return n > inline_bells ? u.ptr : reinterpret_cast<bell const*>(u.buf); }
+
+  // Set the number of bells, leaving the contents undefined
+  void reset(int num);
+
+  union storage {
+    char buf[ inline_bells * sizeof(bell) ];
+    bell* ptr;
+  } u;
+  int n;                        // The number of bells
 };
 
 RINGING_API ostream& operator<<(ostream& o, const row& r);
@@ -30,10 +30,13 @@ RINGING_START_NAMESPACE
 
 RINGING_USING_STD
 
-void search_base::run( search_base::outputer &o ) const
+void search_base::run( search_base::outputer &o, unsigned threads ) const
 {
   scoped_pointer< context_base > ctx( new_context() );
-  ctx->run( o );
+  if ( threads > 1 ) 
+    ctx->run_parallel( o, threads );
+  else
+    ctx->run( o );
 }
 
 RINGING_END_NAMESPACE
@@ -48,13 +48,18 @@ public:
     virtual bool operator()( const touch &t ) = 0;
   };
 
-  void run( outputer &o ) const;
+  // Run the search using up to the given number of threads.  The 
+  // outputer is never called by two threads at once, but the order in
+  // which touches are output is unspecified when using more than one.  
+  // Searches that do not support threading ignore the number of threads.
+  void run( outputer &o, unsigned threads = 1 ) const;
 
 RINGING_PROTECTED_IMPL:
   class RINGING_API context_base
   {
   public:
     virtual void run( outputer & ) = 0;
+    virtual void run_parallel( outputer &o, unsigned ) { run(o); }
     virtual ~context_base() {}
   };
 
@@ -108,22 +113,23 @@ RINGING_END_DETAILS_NAMESPACE
 
 template < class OutputIterator > 
 void touch_search( const search_base &searcher, 
-		   const OutputIterator &iter )
+		   const OutputIterator &iter, unsigned threads = 1 )
 {
   RINGING_USING_DETAILS
   search_output< OutputIterator > o( iter );
-  searcher.run( o );
+  searcher.run( o, threads );
 }
 
 
 template < class OutputIterator, class UnaryPredicate > 
 void touch_search_until( const search_base &searcher, 
 		         const OutputIterator &iter,
-		         const UnaryPredicate &terminate )
+		         const UnaryPredicate &terminate,
+                         unsigned threads = 1 )
 {
   RINGING_USING_DETAILS
   search_output_until< OutputIterator, UnaryPredicate > o( iter, terminate );
-  searcher.run( o );
+  searcher.run( o, threads );
 }
 
 RINGING_END_NAMESPACE
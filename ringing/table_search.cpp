@@ -24,11 +24,20 @@
 #pragma implementation
 #endif
 
+#if RINGING_OLD_C_INCLUDES
+#include <limits.h>
+#else
+#include <climits>
+#endif
 #if RINGING_OLD_INCLUDES
 #include <vector.h>
 #include <bvector.h>
+#include <deque.h>
+#include <list.h>
 #else
 #include <vector>
+#include <deque>
+#include <list>
 #endif
 #include <ringing/search_base.h>
 #include <ringing/table_search.h>
@@ -37,6 +46,8 @@
 #include <ringing/extent.h>
 #include <ringing/touch.h>
 #include <ringing/group.h>
+#include <ringing/pointers.h>
+#include <ringing/thread.h>
 
 #define DEBUG_LEVEL 0
 
@@ -72,7 +83,7 @@ static pair<size_t, size_t>
 table_search::table_search( const method &meth, const vector<change> &calls,
 			    const group& partends, flags f )
   : meth( meth ), calls( calls ), partends( partends ),
-    lenrange( make_pair( size_t(0), size_t(-1) ) ),  f(f)
+    lenrange( make_pair( size_t(0), size_t(-1) ) ),  f(f), split_depth(0)
 {}
 
 table_search::table_search( const method &meth, const vector<change> &calls,
@@ -81,7 +92,7 @@ table_search::table_search( const method &meth, const vector<change> &calls,
   : meth( meth ), calls( calls ), partends( partends ),
     lenrange( range_div( lenrange, f & length_in_changes
                                      ? partends.size() * meth.length() : 1) ),
-    f( f )
+    f( f ), split_depth( 0 )
 {
   DEBUG( "Length range set to " << lenrange.first << "-" << lenrange.second 
          << " leads" );
@@ -90,12 +101,13 @@ table_search::table_search( const method &meth, const vector<change> &calls,
 table_search::table_search( const method &meth, const vector<change> &calls,
                             bool set_nr )
   : meth( meth ), calls( calls ),
-    f( set_nr ? ignore_rotations : no_flags )
+    f( set_nr ? ignore_rotations : no_flags ), split_depth( 0 )
 {}
 
 table_search::table_search( const method &meth, const vector<change> &calls,
                             pair< size_t, size_t > _lenrange, bool set_nr )
-  : meth( meth ), calls( calls ), f( set_nr ? ignore_rotations : no_flags )
+  : meth( meth ), calls( calls ), f( set_nr ? ignore_rotations : no_flags ),
+    split_depth( 0 )
 {
 	lenrange = range_div(_lenrange, f & length_in_changes
 		? partends.size() * meth.length() : 1);
@@ -110,15 +122,14 @@ public:
   context( const table_search *s ) 
     : lenrange( s->lenrange ),  impossible( false ),
       table( make_table( s ) ),
-      f( s->f )
+      f( s->f ), split_depth( s->split_depth ), 
+      plain( s->meth.begin(), s->meth.end()-1 ), halted( false )
   {
     DEBUG( "Constructing context: table size " << table.size() );
 
     row le; 
     for_each( s->meth.begin(), s->meth.end()-1, permute(le) );
       
-    t.push_back( new touch_changes( s->meth.begin(), s->meth.end()-1 ) );
-
     // The plain lead is a call too.      
     init_call( le, s->meth.back() );
     
@@ -127,20 +138,184 @@ public:
 
     DEBUG( "Initialised " << s->calls.size() << " calls" );
     
-    t.push_back( tl = new touch_child_list );    
-    t.set_head( tl );
-
     init_falseness( s->meth, 
              (is_fixed_treble(s) ? 0 : falseness_table::no_fixed_treble) 
            | (!is_in_course(s)   ? 0 : falseness_table::in_course_only ) );
 
     DEBUG( "Initialised " << falsenesses.size() << " flhs" );
+
+    init_false_leads();
+
+    // Failing to write the cache is not an error: the next search 
+    // just builds the table again.
+    if ( !s->table_cache.empty() && !table.cached() ) 
+      table.save( s->table_cache );
   }
 
 private:
   typedef multtab::post_col_t post_col_t;
   typedef multtab::row_t row_t;
 
+  // The leads had so far, packed one bit per row of the table.  This
+  // used to be a vector<char> as vector<bool> was measurably slower;
+  // packing the bits by hand avoids the proxy references that made 
+  // vector<bool> slow, and means that the whole vector fits in L1 cache
+  // for Major.
+  typedef unsigned long lead_word_t;
+  typedef vector< lead_word_t > lead_vector_t; 
+  enum { lead_word_bits = sizeof(lead_word_t) * CHAR_BIT };
+
+  // How many nodes each thread searches between checking whether 
+  // another has halted the search
+  enum { halt_check_interval = 1024 };
+
+  // A subtree of the search, identified by the calls leading to it.
+  struct task 
+  {
+    vector< size_t > calls;
+    row_t r;
+    size_t cur;
+  };
+
+  // The state of one thread of the search.
+  struct state
+  {
+    state( const context &ctx, outputer &output ) 
+      : output( output ), force_halt( false ), nodes( 0ul ), 
+        unchecked( 0u ),
+        leads( ( ctx.table.size() + lead_word_bits - 1 ) / lead_word_bits ), 
+        frontier( NULL ), split( 0u )
+    {
+      t.push_back( new touch_changes( ctx.plain.begin(), ctx.plain.end() ) );
+
+      for ( size_t i=0; i < ctx.lead_ends.size(); ++i ) {
+        touch_changes *c; // the lead end change
+        touch_child_list *cl; // the whole lead
+        t.push_back( c = new touch_changes() );
+        t.push_back( cl = new touch_child_list );
+        cl->push_back( 1, t.get_node(0) );
+        cl->push_back( 1, c );
+        c->push_back( ctx.lead_ends[i] );
+      }
+
+      t.push_back( tl = new touch_child_list );    
+      t.set_head( tl );
+    }
+
+    outputer &output;
+    bool force_halt;			// Are we terminating the search?
+    vector< size_t > calls;		// The calls we've had so far
+    touch t;				// The current touch
+    touch_child_list *tl;
+    RINGING_ULLONG nodes;               // Node count
+    unsigned unchecked;                 // Nodes since checking for a halt
+    lead_vector_t leads;		// The leads had so far
+
+    void set_lead( const row_t &r ) 
+      { leads[ r.index() / lead_word_bits ] 
+          |= lead_word_t(1) << r.index() % lead_word_bits; }
+    void clear_lead( const row_t &r ) 
+      { leads[ r.index() / lead_word_bits ] 
+          &= ~( lead_word_t(1) << r.index() % lead_word_bits ); }
+
+    // If set, subtrees at the split depth are added here
+    vector< task > *frontier;
+    size_t split;
+  };
+
+  // Serialises calls to the outputer from the different threads, and
+  // tells them all when to halt.  The halted flag is only read or 
+  // written with the mutex held.
+  class shared_output : public outputer
+  {
+  public:
+    shared_output( outputer &o, mutex &m, bool &halted ) 
+      : o(o), m(m), halted(halted) {}
+
+    virtual bool operator()( const touch &t )
+    {
+      mutex::scoped_lock lock( m );
+      if ( !halted ) halted = o(t);
+      return halted;
+    }
+
+  private:
+    outputer &o;
+    mutex &m;
+    bool &halted;
+  };
+
+  // Whether any thread has halted the search
+  bool is_halted() const
+  {
+    mutex::scoped_lock lock( halt_mutex );
+    return halted;
+  }
+
+  // One thread of a multithreaded search.  Each worker takes subtrees
+  // from its own queue, and when that is empty, steals them from the 
+  // back of the fullest other queue.
+  class worker : public thread_task
+  {
+  public:
+    worker( const context &ctx, outputer &output, vector<task> const& tasks,
+            vector< shared_pointer<worker> > &workers )
+      : ctx( ctx ), st( ctx, output ), tasks( tasks ), workers( workers )
+    {}
+
+    void push( size_t t ) { queue.push_back(t); }
+
+    virtual void run()
+    {
+      size_t t;
+      while ( !ctx.is_halted() && ( pop(t) || steal(t) ) ) 
+        ctx.run_task( st, tasks[t] );
+    }
+
+  private:
+    bool pop( size_t &t ) 
+    {
+      mutex::scoped_lock lock( m );
+      if ( queue.empty() ) return false;
+      t = queue.front();  queue.pop_front();
+      return true;
+    }
+
+    bool steal( size_t &t ) 
+    {
+      while (true) {
+        worker *victim = NULL;  size_t most = 0;
+        for ( size_t i = 0; i < workers.size(); ++i ) {
+          size_t const n = workers[i]->remaining();
+          if ( n > most ) { most = n;  victim = workers[i].get(); }
+        }
+        if ( !victim ) return false;
+
+        mutex::scoped_lock lock( victim->m );
+        if ( !victim->queue.empty() ) {
+          t = victim->queue.back();  victim->queue.pop_back();
+          return true;
+        }
+      }
+    }
+
+    size_t remaining()
+    {
+      mutex::scoped_lock lock( m );
+      return queue.size();
+    }
+
+    const context &ctx;
+    state st;
+    vector<task> const& tasks;
+    vector< shared_pointer<worker> > &workers;
+    mutex m;
+    deque<size_t> queue;
+  };
+
+  friend struct state;
+  friend class worker;
+
   static bool is_in_course( const table_search *s )
   {
     if ( s->meth.lh().sign() == -1 ) {
@@ -176,12 +351,14 @@ private:
     if ( is_fixed_treble(s) ) {
       DEBUG( "Fixed treble" );
       return multtab( extent_iterator( s->meth.bells() - 1, 1),
-		      extent_iterator(), s->partends );
+		      extent_iterator(), s->partends, group(), 
+                      s->table_cache );
     }
     else {
       DEBUG( "No fixed treble" );
       return multtab( extent_iterator( s->meth.bells() ),
-		      extent_iterator(), s->partends );
+		      extent_iterator(), s->partends, group(), 
+                      s->table_cache );
    }
   }
 
@@ -196,9 +373,7 @@ private:
       // -- our proof algorithm doesn't check when a lead is false against
       // itself, and for an n-part touch a lead being false against the
       // part end is a form of that.
-      if ( !i->isrounds() && 
-           find( table.partends().begin(), table.partends().end(), *i )
-             != table.partends().end() )
+      if ( !i->isrounds() && table.partends().contains(*i) )
         impossible = true;
 
       DEBUG( "FLH: " << *i );
@@ -206,73 +381,184 @@ private:
     }
   }
 
+  // Tabulate the products of each row with the false lead heads, so
+  // that they can be looked up as one contiguous block.
+  void init_false_leads()
+  {
+    narrow = table.size() <= size_t(USHRT_MAX) + 1;
+    if ( narrow )
+      fill_false_leads( false_leads16 );
+    else
+      fill_false_leads( false_leads32 );
+  }
+
+  template <class T>
+  void fill_false_leads( vector<T> &fl ) const
+  {
+    fl.reserve( table.size() * falsenesses.size() );
+    for ( multtab::row_iterator i = table.begin_rows(), e = table.end_rows();
+          i != e; ++i )
+      for ( vector< post_col_t >::const_iterator j( falsenesses.begin() ); 
+            j != falsenesses.end(); ++j )
+        fl.push_back( ( *i * *j ).index() );
+  }
+
   void init_call( const row &le, const change &ch )
   {
-    touch_changes *c; // the lead end change
-    touch_child_list *cl; // the whole lead
-    
-    t.push_back( c = new touch_changes() );
-    t.push_back( cl = new touch_child_list );
-    cl->push_back( 1, t.get_node(0) );
-    cl->push_back( 1, c );
-    c->push_back( ch );
-    
+    lead_ends.push_back( ch );
     call_lhs.push_back( table.compute_post_mult( le * ch ) );
   }
   
   // Keep looking for touches, pushing them down the outputer.
   virtual void run( outputer &output ) 
+  {
+    run_parallel( output, 1u );
+  }
+
+  virtual void run_parallel( outputer &output, unsigned threads ) 
   {
     // We might have already determined that the search cannot find anything
     // If so, we need to abort because the search may otherwise fail (i.e.
     // list false touches).
-    if ( !impossible ) {
-      force_halt = false;
-      nodes = 0ul;
-      lead_vector_t( table.size(), false ).swap( leads );
-      run_recursive( output, row_t(), 0, 0 );
-      DEBUG( "Searched " << nodes << " nodes" );
+    if ( impossible ) 
+      return;
+
+    {
+      mutex::scoped_lock lock( halt_mutex );
+      halted = false;
+    }
+    shared_output shared( output, halt_mutex, halted );
+
+    if ( threads <= 1 ) {
+      state st( *this, shared );
+      run_recursive( st, row_t(), 0, 0 );
+      DEBUG( "Searched " << st.nodes << " nodes" );
+      return;
+    }
+
+    // Search as far as the split depth, collecting the subtrees below it.
+    // Touches shorter than the split depth are output immediately.
+    vector<task> tasks;
+    {
+      state st( *this, shared );
+      st.frontier = &tasks;
+      st.split = get_split_depth( threads );
+      run_recursive( st, row_t(), 0, 0 );
+    }
+    DEBUG( "Split into " << tasks.size() << " subtrees" );
+
+    if ( is_halted() || tasks.empty() ) 
+      return;
+
+    if ( threads > tasks.size() ) 
+      threads = tasks.size();
+
+    vector< shared_pointer<worker> > workers;
+    for ( unsigned i = 0; i < threads; ++i )
+      workers.push_back( shared_pointer<worker>
+        ( new worker( *this, shared, tasks, workers ) ) );
+
+    // Interleave the subtrees so that each thread starts with a 
+    // mixture of large and small ones.
+    for ( size_t i = 0; i < tasks.size(); ++i )
+      workers[ i % threads ]->push(i);
+
+    vector<thread_task*> tt;
+    for ( unsigned i = 0; i < threads; ++i )
+      tt.push_back( workers[i].get() );
+    run_threads( tt );
+  }
+
+  // The depth at which to split the search when using the given 
+  // number of threads.
+  size_t get_split_depth( unsigned threads ) const
+  {
+    if ( split_depth ) 
+      return split_depth;
+
+    // Aim for plenty of subtrees per thread so that they can be 
+    // balanced even though their sizes vary widely.
+    size_t d = 1, n = call_lhs.size();
+    while ( n < 64 * threads && call_lhs.size() > 1 && d < 16 ) 
+      ++d, n *= call_lhs.size();
+    return d;
+  }
+
+  // Search one subtree in the given state
+  void run_task( state &st, const task &t ) const
+  {
+    size_t const depth = t.calls.size();
+
+    // Replay the leads leading to this subtree
+    row_t r;
+    for ( size_t i = 0; i < depth; ++i ) {
+      st.set_lead(r);
+      r = r * call_lhs[ t.calls[i] ];
+    }
+    
+    st.calls = t.calls;
+    run_recursive( st, t.r, depth, t.cur );
+
+    r = row_t();
+    for ( size_t i = 0; i < depth; ++i ) {
+      st.clear_lead(r);
+      r = r * call_lhs[ t.calls[i] ];
     }
   }
 
   // Is the row false against a row that we've already had?
-  bool is_row_false( const row_t &r )
+  bool is_row_false( const state &st, const row_t &r ) const
   {
-    for ( vector< post_col_t >::const_iterator i( falsenesses.begin() ); 
-	  i != falsenesses.end(); ++i )
-      if ( leads[ (r * *i).index() ] )
-	return true;
+    size_t const n = falsenesses.size();
+    if ( n == 0 ) 
+      return false;
+    else if ( narrow )
+      return any_lead( st.leads, &false_leads16[ r.index() * n ], n );
+    else
+      return any_lead( st.leads, &false_leads32[ r.index() * n ], n );
+  }
 
+  // Whether any of the n leads starting at fl have been had.  (ORing 
+  // together all n bits without branching was measured, and is slower 
+  // than returning at the first lead found.)
+  template <class T>
+  static bool any_lead( const lead_vector_t &leads, const T *fl, size_t n )
+  {
+    for ( const T *e = fl + n; fl != e; ++fl )
+      if ( leads[ *fl / lead_word_bits ] >> *fl % lead_word_bits & 1 )
+        return true;
     return false;
   }
 
   // Output the current touch and any rotations of it.
-  void output_touch( outputer &output, size_t cur )
+  void output_touch( state &st, size_t cur ) const
   {
+    vector< size_t > const& calls = st.calls;
     size_t len( calls.size() );
-    list< touch_child_list::entry > &ch = tl->children();
+    list< touch_child_list::entry > &ch = st.tl->children();
 
     ch.clear();
     
     for ( size_t i=0; i < len; ++i )
-      tl->push_back( 1, t.get_node( 2 * (1 + calls[i]) ) );
+      st.tl->push_back( 1, st.t.get_node( 2 * (1 + calls[i]) ) );
 
     // If we want more than mutually true blocks, make sure it is 
     // actually an n-part.
     if ( !(f & mutually_true_parts) && table.partends().size() > 1 ) {
-      if ( for_each( t.begin(), t.end(), permute(table.bells()) ).get().order()
+      if ( for_each( st.t.begin(), st.t.end(), 
+                     permute(table.bells()) ).get().order()
              != table.partends().size() )
         return;
     }
 
-    force_halt = output( t );
+    st.force_halt = st.output( st.t );
 
     // Try all of it's distinguishable rotations.
     if ( !(f & ignore_rotations) && table.partends().size() == 1 ) {
       size_t parts( len % cur ? cur : len / cur );
-      for ( size_t start = 1; !force_halt && start < len / parts; ++start ) {
+      for ( size_t start = 1; !st.force_halt && start < len / parts; ++start ) {
         ch.splice( ch.end(), ch, ch.begin() );
-        force_halt = output( t );
+        st.force_halt = st.output( st.t );
       }
     }
   }
@@ -282,8 +568,10 @@ private:
 
   // This function returns true if the current fragment could possibly be
   // at the start of a canonical touch.
-  bool is_possibly_canonical( size_t &cur )
+  bool is_possibly_canonical( const state &st, size_t &cur ) const
   {
+    vector< size_t > const& calls = st.calls;
+
     if ( calls.empty() )
       return true;
 
@@ -301,8 +589,10 @@ private:
 
   // ... and this function checks that a touch fragment for which 
   // is_possibly_canonical() returns true is a canonical complete touch.
-  bool is_really_canonical()
+  bool is_really_canonical( const state &st ) const
   {
+    vector< size_t > const& calls = st.calls;
+
     // Multipart comps are always canonical (because we don't prue rotations
     // from multi-part searches)
     if ( table.partends().size() > 1 ) return true;
@@ -315,65 +605,87 @@ private:
   }
 
   // The main loop of the algorithm   
-  void run_recursive( outputer &output, const row_t &r, 
-                      size_t depth, size_t cur )
+  void run_recursive( state &st, const row_t &r, 
+                      size_t depth, size_t cur ) const
   {
 #if DEBUG_LEVEL > 1
-    IF_DEBUG( copy( calls.begin(), calls.end(), ostream_iterator<int>(cout) ));
+    IF_DEBUG( copy( st.calls.begin(), st.calls.end(), 
+                    ostream_iterator<int>(cout) ));
     DEBUG( " at depth " << depth );
 #endif
 
-    IF_DEBUG( (++nodes % 1000000 == 0) && (cout << "Node: " << nodes << "\n") );
+    IF_DEBUG( (++st.nodes % 1000000 == 0) 
+              && (cout << "Node: " << st.nodes << "\n") );
+
+    // Another thread may have halted the search.  Checking takes the 
+    // lock, so is only done every so often.
+    if ( ++st.unchecked == halt_check_interval ) {
+      st.unchecked = 0u;
+      if ( is_halted() ) {
+        st.force_halt = true;
+        return;
+      }
+    }
+
+    // When splitting the search, stop at the split depth
+    if ( st.frontier && depth == st.split ) {
+      task t;  t.calls = st.calls;  t.r = r;  t.cur = cur;
+      st.frontier->push_back(t);
+      return;
+    }
 
     // Is the touch lexicographically no greater than any of it's rotations?
-    if ( !is_possibly_canonical( cur ) )
+    if ( !is_possibly_canonical( st, cur ) )
       return;
 
     // Is the going to repeat?
-    else if ( is_row_false( r ) )
+    else if ( is_row_false( st, r ) )
       {
 	// Has it come round, and is it in it's canonical form?
 	if ( depth >= lenrange.first 
              && ( (f & non_round_blocks) || r.isrounds() ) 
-             && is_really_canonical() )
-	  output_touch( output, cur );
+             && is_really_canonical( st ) )
+	  output_touch( st, cur );
       }
     else if ( depth < lenrange.second )
       {
-	leads[r.index()] = true;
+        vector< size_t > &calls = st.calls;
+	st.set_lead(r);
 	calls.push_back( 0 );
 	
-	for ( ; !force_halt && calls.back() < call_lhs.size(); ++calls.back() )
+	for ( ; !st.force_halt && calls.back() < call_lhs.size(); 
+              ++calls.back() )
 	  {
-	    run_recursive( output, r * call_lhs[ calls.back() ], 
+	    run_recursive( st, r * call_lhs[ calls.back() ], 
 			   depth + 1, cur );
 	  }
 	
 	calls.pop_back();
-	leads[r.index()] = false;
+	st.clear_lead(r);
       }
   }
  
 private:
   // Data members
   pair< size_t, size_t > lenrange;	// The min & max lengths (in leads)
-  bool force_halt;			// Are we terminating the search?
   bool impossible;                      // Whether the search cannot succeed
-  vector< size_t > calls;		// The calls we've had so far
-  touch t;				// The current touch
-  touch_child_list *tl;
   multtab table;			// A precomputed multiplication table
   flags f;	                        // Are we to ignore rotations, etc.
-  RINGING_ULLONG nodes;                 // Node count
-
-  // Logically this is a vector<bool>, but the C++ standard mandates 
-  // that that should be a packed structure.  Changing to vector<char>
-  // makes a small but significant speed improvement.
-  typedef vector<char> lead_vector_t; 
+  size_t split_depth;                   // Where to split a threaded search
 
-  lead_vector_t leads;			// The leads had so far
+  vector< change > plain;               // The plain lead, less lead end
+  vector< change > lead_ends;           // The lead end of each call
   vector< post_col_t > call_lhs;	// The effect of each call (inc. Pl.)
   vector< post_col_t > falsenesses;	// The falsenesses of the method
+
+  // The product of each row with each false lead head, stored by row
+  // in 16 bits if possible, or in 32 bits otherwise.
+  bool narrow;
+  vector< unsigned short > false_leads16;
+  vector< unsigned int > false_leads32;
+
+  mutable mutex halt_mutex;             // Guards halted and the output
+  bool halted;                          // Has any thread halted?
 };
 
 search_base::context_base *table_search::new_context() const 
@@ -32,8 +32,10 @@
 
 #if RINGING_OLD_INCLUDES
 #include <vector.h>
+#include <string.h>
 #else
 #include <vector>
+#include <string>
 #endif
 #include <ringing/row.h>
 #include <ringing/method.h>
@@ -86,6 +88,16 @@ public:
                 pair< size_t, size_t > lenrange, 
                 bool set_ignore_rotations = false);
 
+  // A multithreaded search is split into independent subtrees at this 
+  // number of leads.  The default of 0 chooses a depth giving several
+  // dozen subtrees per thread.
+  void set_split_depth( size_t depth ) { split_depth = depth; }
+
+  // Read the multiplication table from this file if a table for the 
+  // same search has been saved there, and otherwise save it there.
+  // See multtab for details.
+  void set_table_cache( const string& filename ) { table_cache = filename; }
+
 private:
   // The implementation
   class context;
@@ -98,6 +110,8 @@ private:
   group partends;
   pair< size_t, size_t > lenrange; // The minimum and maximum number of leads
   flags f;
+  size_t split_depth;
+  string table_cache;
 };
 
 
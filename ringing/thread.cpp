@@ -0,0 +1,147 @@
+// -*- C++ -*- thread.cpp - Simple portable threading primitives
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/common.h>
+
+#if RINGING_HAS_PRAGMA_INTERFACE
+#pragma implementation
+#endif
+
+#if RINGING_OLD_INCLUDES
+#include <stdexcept.h>
+#include <string.h>
+#else
+#include <stdexcept>
+#include <string>
+#endif
+#if RINGING_USE_THREADS
+#include <unistd.h>
+#endif
+
+#include <ringing/thread.h>
+#include <ringing/pointers.h>
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+#if RINGING_USE_THREADS
+
+mutex::mutex()
+{
+  pthread_mutex_init( &m, NULL );
+}
+
+mutex::~mutex()
+{
+  pthread_mutex_destroy( &m );
+}
+
+void mutex::lock()
+{
+  pthread_mutex_lock( &m );
+}
+
+void mutex::unlock()
+{
+  pthread_mutex_unlock( &m );
+}
+
+RINGING_START_ANON_NAMESPACE
+
+struct thread_info
+{
+  thread_info( thread_task* t ) : t(t), failed(false) {}
+
+  thread_task* t;
+  pthread_t id;
+  bool failed;
+  string what;
+};
+
+extern "C" void* start_thread( void* p )
+{
+  thread_info* info = static_cast<thread_info*>(p);
+  try {
+    info->t->run();
+  }
+  catch ( exception const& ex ) {
+    info->failed = true;  info->what = ex.what();
+  }
+  catch ( ... ) {
+    info->failed = true;  info->what = "Unknown exception in thread";
+  }
+  return NULL;
+}
+
+RINGING_END_ANON_NAMESPACE
+
+void run_threads( vector<thread_task*> const& tasks )
+{
+  vector<thread_info> info( tasks.begin(), tasks.end() );
+
+  // The first task is run in this thread; if a thread cannot be
+  // created, its task is run here too.
+  vector<bool> started( info.size() );
+  for ( size_t i = 1; i < info.size(); ++i )
+    started[i] = pthread_create( &info[i].id, NULL, &start_thread,
+                                 &info[i] ) == 0;
+
+  for ( size_t i = 0; i < info.size(); ++i )
+    if ( !started[i] ) start_thread( &info[i] );
+
+  for ( size_t i = 1; i < info.size(); ++i )
+    if ( started[i] ) pthread_join( info[i].id, NULL );
+
+  for ( size_t i = 0; i < info.size(); ++i )
+    if ( info[i].failed )
+      throw runtime_error( info[i].what );
+}
+
+unsigned hardware_concurrency()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long const n = sysconf( _SC_NPROCESSORS_ONLN );
+  if ( n > 0 ) return n;
+#endif
+  return 1;
+}
+
+#else
+
+mutex::mutex() {}
+mutex::~mutex() {}
+void mutex::lock() {}
+void mutex::unlock() {}
+
+void run_threads( vector<thread_task*> const& tasks )
+{
+  for ( vector<thread_task*>::const_iterator i = tasks.begin(),
+          e = tasks.end(); i != e; ++i )
+    (*i)->run();
+}
+
+unsigned hardware_concurrency()
+{
+  return 1;
+}
+
+#endif // RINGING_USE_THREADS
+
+RINGING_END_NAMESPACE
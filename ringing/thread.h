@@ -0,0 +1,103 @@
+// -*- C++ -*- thread.h - Simple portable threading primitives
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#ifndef RINGING_THREAD_H
+#define RINGING_THREAD_H
+
+#include <ringing/common.h>
+
+#if RINGING_HAS_PRAGMA_ONCE
+#pragma once
+#endif
+
+#if RINGING_HAS_PRAGMA_INTERFACE
+#pragma interface
+#endif
+
+#if RINGING_OLD_INCLUDES
+#include <vector.h>
+#else
+#include <vector>
+#endif
+
+#if RINGING_USE_THREADS
+#include <pthread.h>
+#endif
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+// If the library was built without thread support, a mutex does nothing
+// and the tasks passed to run_threads are run one after another in the
+// calling thread.  Code using these should therefore not rely on two
+// tasks running at the same time.
+
+class RINGING_API mutex
+{
+public:
+  mutex();
+ ~mutex();
+
+  void lock();
+  void unlock();
+
+  class scoped_lock
+  {
+  public:
+    explicit scoped_lock( mutex& m ) : m(m) { m.lock(); }
+   ~scoped_lock() { m.unlock(); }
+
+  private:
+    // Unimplemented
+    scoped_lock( scoped_lock const& );
+    scoped_lock& operator=( scoped_lock const& );
+
+    mutex& m;
+  };
+
+private:
+  // Unimplemented
+  mutex( mutex const& );
+  mutex& operator=( mutex const& );
+
+#if RINGING_USE_THREADS
+  pthread_mutex_t m;
+#endif
+};
+
+class RINGING_API thread_task
+{
+public:
+  virtual ~thread_task() {}
+  virtual void run() = 0;
+};
+
+// Run each task in a thread of its own, and wait for them all to finish.
+// If any task throws an exception, a runtime_error with the same message
+// is thrown once all the tasks have finished.
+RINGING_API void run_threads( vector<thread_task*> const& tasks );
+
+// The number of threads that can usefully run at once, or 1 if that
+// cannot be determined.
+RINGING_API unsigned hardware_concurrency();
+
+RINGING_END_NAMESPACE
+
+#endif // RINGING_THREAD_H
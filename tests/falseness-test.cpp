@@ -0,0 +1,126 @@
+// -*- C++ -*- falseness-test.cpp - Tests for the falseness classes
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/falseness.h>
+#include <ringing/group.h>
+#include <ringing/method.h>
+#include "test-base.h"
+#include <set>
+#include <vector>
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+RINGING_START_ANON_NAMESPACE
+
+void test_falseness_table_contents(void)
+{
+  method const m( "&-36-14-12-36-14-56,12", 6 );
+  row_block const rb( m, row_block::no_final_lead_head );
+
+  set<row> fs;
+  for ( row_block::const_iterator i( rb.begin() ), e( rb.end() ); i != e; ++i )
+    for ( row_block::const_iterator j( rb.begin() ); j != e; ++j )
+      if ( (*i / *j)[0] == 0 )
+        fs.insert( *i / *j );
+
+  falseness_table const ft( m );
+  RINGING_TEST( ft.size() == fs.size() );
+  RINGING_TEST( equal( ft.begin(), ft.end(), fs.begin() ) );
+
+  // In-course only removes the odd rows
+  falseness_table const ic( m, falseness_table::in_course_only );
+  for ( falseness_table::const_iterator i( ic.begin() ), e( ic.end() ); 
+        i != e; ++i )
+    RINGING_TEST( i->sign() == +1 );
+  RINGING_TEST( ic.size() < ft.size() );
+}
+
+void test_falseness_table_cache(void)
+{
+  method const a( "&-36-14-12-36-14-56,12", 6 );
+  method const b( "&-36-14-12-36.14-14.36,12", 6 );
+
+  falseness_table const ab1( a, b ), ab2( a, b ), ba( b, a );
+  RINGING_TEST( ab1.size() == ab2.size() );
+  RINGING_TEST( equal( ab1.begin(), ab1.end(), ab2.begin() ) );
+
+  // The order of the methods matters, and is part of the key
+  set<row> inv;
+  for ( falseness_table::const_iterator i( ba.begin() ), e( ba.end() ); 
+        i != e; ++i )
+    inv.insert( i->inverse() );
+  RINGING_TEST( inv.size() == ab1.size() );
+  RINGING_TEST( equal( ab1.begin(), ab1.end(), inv.begin() ) );
+
+  // So are the flags
+  falseness_table const ic( a, b, falseness_table::in_course_only );
+  RINGING_TEST( ic.size() < ab1.size() );
+
+  falseness_table::cache_size(0);
+  falseness_table const ab3( a, b );
+  RINGING_TEST( equal( ab1.begin(), ab1.end(), ab3.begin() ) );
+  falseness_table::cache_size(256);
+}
+
+void test_falseness_table_group_order(void)
+{
+  method const a( "&-36-14-12-36-14-56,12", 6 );
+  method const b( "&-36-14-12-36.14-14.36,12", 6 );
+  method const c( "&-34-14-12-36-14-56,12", 6 );
+
+  int const flags[] = { 0, falseness_table::in_course_only, 
+                        falseness_table::out_of_course_only };
+  for ( size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i ) {
+    falseness_table const ab( a, b, flags[i] ), ac( a, c, flags[i] ), 
+      aa( a, flags[i] );
+    RINGING_TEST( ab.group_order() == ab.generate_group().size() );
+    RINGING_TEST( ac.group_order() == ac.generate_group().size() );
+    RINGING_TEST( aa.group_order() == aa.generate_group().size() );
+  }
+}
+
+void test_false_courses(void)
+{
+  method const m( "&x38x14x1258x36x14x58x16x78,12", 8 );
+  false_courses const fch( m, false_courses::in_course_only 
+                              | false_courses::tenors_together );
+  RINGING_TEST( fch.symbols() == "ABDE" );
+
+  false_courses const fch2( m, false_courses::in_course_only 
+                               | false_courses::tenors_together );
+  RINGING_TEST( fch2.size() == fch.size() );
+  RINGING_TEST( fch2.symbols() == "ABDE" );
+
+  RINGING_TEST( false_courses( m ).size() > fch.size() );
+}
+
+RINGING_END_ANON_NAMESPACE
+
+RINGING_START_TEST_FILE( falseness )
+
+  RINGING_REGISTER_TEST( test_falseness_table_contents )
+  RINGING_REGISTER_TEST( test_falseness_table_cache )
+  RINGING_REGISTER_TEST( test_falseness_table_group_order )
+  RINGING_REGISTER_TEST( test_false_courses )
+
+RINGING_END_TEST_FILE
+
+RINGING_END_NAMESPACE
@@ -0,0 +1,132 @@
+// -*- C++ -*- group-test.cpp - Tests for the group class
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/group.h>
+#include <ringing/multtab.h>
+#include <ringing/extent.h>
+#include "test-base.h"
+#include <vector>
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+RINGING_START_ANON_NAMESPACE
+
+vector<row> make_gens( char const* g1, char const* g2 = 0 )
+{
+  vector<row> gens( 1u, row(g1) );
+  if (g2) gens.push_back( row(g2) );
+  return gens;
+}
+
+void test_group_chain_order(void)
+{
+  RINGING_TEST( group( make_gens("2134"), group::chained ).size() == 2 );
+  RINGING_TEST( group( make_gens("23451"), group::chained ).size() == 5 );
+  RINGING_TEST( group( make_gens("2134", "23451"), group::chained ).size() 
+                == 120 );
+  RINGING_TEST( group( make_gens("13425678", "12345786"), 
+                       group::chained ).size() == 9 );
+  RINGING_TEST( group( make_gens("21345678", "23456781"), 
+                       group::chained ).size() == 40320 );
+  RINGING_TEST( group( vector<row>(), group::chained ).size() == 1 );
+
+  char const* gens[][2] = { { "21436587", "13527486" }, 
+                            { "2143657", "1352746" },
+                            { "3124567", "1235476" },
+                            { "1324567", "2143675" } };
+  for ( size_t i = 0; i < sizeof(gens) / sizeof(gens[0]); ++i )
+    RINGING_TEST( group( make_gens( gens[i][0], gens[i][1] ), 
+                         group::chained ).size() 
+                  == group( make_gens( gens[i][0], gens[i][1] ) ).size() );
+}
+
+void test_group_chain_contains(void)
+{
+  group const g( make_gens("214365", "351624") );
+  group const c( make_gens("214365", "351624"), group::chained );
+  RINGING_TEST( c.is_chained() && !g.is_chained() );
+  RINGING_TEST( c.size() == g.size() && c.size() < 720 );
+
+  for ( extent_iterator i(6), e; i != e; ++i )
+    RINGING_TEST( c.contains(*i) == g.contains(*i) );
+
+  // Extra bells are fine so long as they are fixed
+  group const s( make_gens("2134", "23451"), group::chained );
+  for ( extent_iterator i(6), e; i != e; ++i )
+    RINGING_TEST( s.contains(*i) == ( (*i)[5] == 5 ) );
+
+  group const a( group::alternating_group(6) );
+  group const ac( make_gens("231456", "134562"), group::chained );
+  RINGING_TEST( ac.size() == a.size() );
+  for ( extent_iterator i(6), e; i != e; ++i )
+    RINGING_TEST( ac.contains(*i) == ( i->sign() > 0 ) );
+}
+
+void test_group_chain_labels(void)
+{
+  group const g( make_gens("13425678", "12345786") );
+  group const c( make_gens("13425678", "12345786"), group::chained );
+  RINGING_TEST( g == c );
+  RINGING_TEST( !( g < c ) && !( c < g ) );
+  RINGING_TEST( c != group( make_gens("13425678"), group::chained ) );
+
+  for ( extent_iterator i(7, 1), e; i != e; ++i ) {
+    row const r( c.rcoset_label(*i) );
+    RINGING_TEST( c.lcoset_label(*i) == g.lcoset_label(*i) );
+    RINGING_TEST( g.rcoset_label(r) == g.rcoset_label(*i) );
+
+    for ( group::const_iterator j( g.begin() ), je( g.end() ); j != je; ++j )
+      RINGING_TEST( c.rcoset_label( *j * *i ) == r );
+  }
+
+  RINGING_TEST( c.rcoset_label( row("13425678") ).isrounds() );
+}
+
+void test_group_chain_multtab(void)
+{
+  vector<row> gens( 1u, row("134256") );
+  multtab t( extent_iterator(5, 1), extent_iterator(), 
+             group( gens, group::chained ) );
+  multtab u( extent_iterator(5, 1), extent_iterator(), group( gens ) );
+  RINGING_TEST( t.size() == u.size() );
+
+  multtab::post_col_t const bob( t.compute_post_mult( change(6, "14") ) );
+  multtab::pre_col_t const pre( t.compute_pre_mult( row("123465") ) );
+
+  for ( extent_iterator i(5, 1), e; i != e; ++i ) {
+    RINGING_TEST( t.find( row("134256") * *i ) == t.find(*i) );
+    RINGING_TEST( t.find(*i) * bob == t.find( *i * change(6, "14") ) );
+    RINGING_TEST( pre * t.find(*i) == t.find( row("123465") * *i ) );
+  }
+}
+
+RINGING_END_ANON_NAMESPACE
+
+RINGING_START_TEST_FILE( group )
+
+  RINGING_REGISTER_TEST( test_group_chain_order )
+  RINGING_REGISTER_TEST( test_group_chain_contains )
+  RINGING_REGISTER_TEST( test_group_chain_labels )
+  RINGING_REGISTER_TEST( test_group_chain_multtab )
+
+RINGING_END_TEST_FILE
+
+RINGING_END_NAMESPACE
@@ -0,0 +1,190 @@
+// -*- C++ -*- multtab-test.cpp - Tests for the multtab class
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/multtab.h>
+#include <ringing/extent.h>
+#include <ringing/change.h>
+#include "test-base.h"
+#include <cstdio>
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+RINGING_START_ANON_NAMESPACE
+
+void test_multtab_find(void)
+{
+  multtab t( extent_iterator(5, 1), extent_iterator() );
+  RINGING_TEST( t.size() == 120 );
+
+  // Every row is found at its own index
+  for ( multtab::row_iterator i = t.begin_rows(), e = t.end_rows();
+        i != e; ++i )
+    RINGING_TEST( t.find( t.find(*i) ) == *i );
+
+  for ( extent_iterator i(5, 1), e; i != e; ++i )
+    RINGING_TEST( t.find( t.find(*i) ) == *i );
+
+  RINGING_TEST( t.find( row("123456") ).isrounds() );
+}
+
+void test_multtab_partends(void)
+{
+  group const pends( row("134256") );
+  multtab t( extent_iterator(5, 1), extent_iterator(), pends );
+  RINGING_TEST( t.size() == 40 );
+
+  // Rows in the same part are represented by the same row
+  for ( extent_iterator i(5, 1), e; i != e; ++i )
+    for ( group::const_iterator p = pends.begin(), pe = pends.end();
+          p != pe; ++p )
+      RINGING_TEST( t.find( *p * *i ) == t.find(*i) );
+}
+
+void test_multtab_mult(void)
+{
+  multtab t( extent_iterator(5, 1), extent_iterator(), group( row("134256") ) );
+  multtab::post_col_t const bob( t.compute_post_mult( change(6, "14") ) );
+  multtab::pre_col_t const pre( t.compute_pre_mult( row("123465") ) );
+
+  for ( multtab::row_iterator i = t.begin_rows(), e = t.end_rows();
+        i != e; ++i ) {
+    RINGING_TEST( *i * bob == t.find( t.find(*i) * change(6, "14") ) );
+    RINGING_TEST( pre * *i == t.find( row("123465") * t.find(*i) ) );
+  }
+
+  // Asking for the same column twice gives the same column
+  RINGING_TEST( t.compute_post_mult( change(6, "14") ) == bob );
+}
+
+void test_sqmulttab(void)
+{
+  sqmulttab t( extent_iterator(5, 1), extent_iterator() );
+
+  for ( extent_iterator i(5, 1), e; i != e; ++i ) {
+    row const r( "132546" );
+    RINGING_TEST( t.find(*i) * t.find(r) == t.find( *i * r ) );
+  }
+}
+
+void test_multtab_cache(void)
+{
+  char const* const file = "multtab-test.cache";
+  remove( file );
+
+  group const pends( row("134256") );
+  multtab t( extent_iterator(5, 1), extent_iterator(), pends, group(), file );
+  RINGING_TEST( !t.cached() );
+  multtab::post_col_t const bob( t.compute_post_mult( change(6, "14") ) );
+  RINGING_TEST( t.save( file ) );
+
+  {
+    multtab t2( extent_iterator(5, 1), extent_iterator(), pends, group(), 
+                file );
+    RINGING_TEST( t2.cached() );
+    RINGING_TEST( t2.size() == t.size() );
+    RINGING_TEST( t2.compute_post_mult( change(6, "14") ) == bob );
+    RINGING_TEST( t2.cached() );
+
+    // A copy outlives the original
+    multtab t3( t2 );
+    t2 = multtab( extent_iterator(5, 1), extent_iterator() );
+
+    for ( multtab::row_iterator i = t.begin_rows(), e = t.end_rows();
+          i != e; ++i ) {
+      RINGING_TEST( t3.find(*i) == t.find(*i) );
+      RINGING_TEST( *i * bob == *i * t3.compute_post_mult( change(6, "14") ) );
+    }
+
+    // Adding a column copies the table out of the file
+    multtab::post_col_t const single
+      ( t3.compute_post_mult( change(6, "1234") ) );
+    RINGING_TEST( !t3.cached() );
+    for ( multtab::row_iterator i = t3.begin_rows(), e = t3.end_rows();
+          i != e; ++i ) {
+      RINGING_TEST( *i * single == t3.find( t3.find(*i) * change(6, "1234") ) );
+      RINGING_TEST( *i * bob == t.find( t.find(*i) * change(6, "14") ) );
+    }
+  }
+
+  // A file corrupted without changing its size is rebuilt
+  {
+    FILE* f = fopen( file, "r+b" );
+    RINGING_TEST( f && fseek( f, -64, SEEK_END ) == 0 );
+    if ( f ) {
+      for ( int i = 0; i < 64; ++i ) putc( 0xFF, f );
+      fclose( f );
+    }
+
+    multtab t2( extent_iterator(5, 1), extent_iterator(), pends, group(),
+                file );
+    RINGING_TEST( !t2.cached() );
+    multtab::post_col_t const bob2( t2.compute_post_mult( change(6, "14") ) );
+    for ( extent_iterator i(5, 1), e; i != e; ++i )
+      RINGING_TEST( t2.find( t2.find(*i) * bob2 ) 
+                    == t.find( t.find(*i) * bob ) );
+  }
+
+  // A different part end group does not use the file
+  multtab t4( extent_iterator(5, 1), extent_iterator(), 
+              group( row("132456") ), group(), file );
+  RINGING_TEST( !t4.cached() );
+  RINGING_TEST( t4.size() == 60 );
+
+  remove( file );
+}
+
+void test_sqmulttab_cache(void)
+{
+  char const* const file = "sqmulttab-test.cache";
+  remove( file );
+
+  sqmulttab t( incourse_extent_iterator(5, 1), incourse_extent_iterator(), 
+               file );
+  RINGING_TEST( !t.cached() );
+
+  sqmulttab t2( incourse_extent_iterator(5, 1), incourse_extent_iterator(), 
+                file );
+  RINGING_TEST( t2.cached() );
+
+  for ( incourse_extent_iterator i(5, 1), e; i != e; ++i ) {
+    row const r( "132546" );
+    RINGING_TEST( t2.find(*i) * t2.find(r) == t2.find( *i * r ) );
+    RINGING_TEST( ( t2.find(*i) * t2.find(r) ).index() 
+                  == ( t.find(*i) * t.find(r) ).index() );
+  }
+
+  remove( file );
+}
+
+RINGING_END_ANON_NAMESPACE
+
+RINGING_START_TEST_FILE( multtab )
+
+  RINGING_REGISTER_TEST( test_multtab_find )
+  RINGING_REGISTER_TEST( test_multtab_partends )
+  RINGING_REGISTER_TEST( test_multtab_mult )
+  RINGING_REGISTER_TEST( test_sqmulttab )
+  RINGING_REGISTER_TEST( test_multtab_cache )
+  RINGING_REGISTER_TEST( test_sqmulttab_cache )
+
+RINGING_END_TEST_FILE
+
+RINGING_END_NAMESPACE
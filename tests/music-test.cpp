@@ -18,7 +18,9 @@
 // $Id$
 
 #include <ringing/music.h>
+#include <ringing/extent.h>
 #include "test-base.h"
+#include <vector>
 
 RINGING_START_NAMESPACE
 
@@ -141,6 +143,41 @@ void test_music_details_score(void)
   // to set it - or hacking into the music_details private functions.
 }
 
+// ---------------------------------------------------------------------
+// Tests for class music
+
+void test_music_process_rows(void)
+{
+  char const* patterns[] = { "123456", "12??56", "*56", "1*", "*456*", 
+                             "*[56]?", "[12]*[56]", "*", "654*", 0 };
+  music mu(6);
+  for ( char const** p = patterns; *p; ++p ) 
+    mu.push_back( music_details( *p, 1, 2 ) );
+
+  // Each row of the extent is matched once by every pattern it fits
+  vector<row> rows;
+  for ( extent_iterator i(6), e; i != e; ++i ) rows.push_back(*i);
+  mu.process_rows( rows.begin(), rows.end() );
+
+  for ( music::const_iterator i = mu.begin(), e = mu.end(); i != e; ++i ) {
+    RINGING_TEST( i->count() == i->possible_matches(6) );
+    RINGING_TEST( i->total() == int( i->count(eHandstroke) 
+                                     + 2 * i->count(eBackstroke) ) );
+  }
+
+  // Handstroke and backstroke are counted and scored separately
+  music mu2(6);
+  mu2.push_back( music_details( "123456", 1, 2 ) );
+  mu2.push_back( music_details( "*56", 1, 2 ) );
+  mu2.push_back( music_details( "654*", 1, 2 ) );
+  RINGING_TEST( mu2.process_row( row("123456") ) );
+  RINGING_TEST( mu2.process_row( row("654321"), true ) );
+  RINGING_TEST( !mu2.process_row( row("214365") ) );
+  RINGING_TEST( mu2.get_count(eHandstroke) == 2 );
+  RINGING_TEST( mu2.get_count(eBackstroke) == 1 );
+  RINGING_TEST( mu2.get_score() == 4 );
+}
+
 // ---------------------------------------------------------------------
 // Register the tests
 
@@ -153,6 +190,9 @@ RINGING_START_TEST_FILE( music )
   RINGING_REGISTER_TEST( test_music_details_possible_matches )
   RINGING_REGISTER_TEST( test_music_details_score )
 
+  // Tests for the music class
+  RINGING_REGISTER_TEST( test_music_process_rows )
+
 RINGING_END_TEST_FILE
 
 RINGING_END_NAMESPACE
@@ -0,0 +1,204 @@
+// -*- C++ -*- proof-test.cpp - Tests for the prover class
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/proof.h>
+#include <ringing/method.h>
+#include "test-base.h"
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+RINGING_START_ANON_NAMESPACE
+
+prover::storage_type const storage_types[] 
+  = { prover::multimap_storage, prover::hash_storage, 
+      prover::extent_storage, prover::automatic_storage };
+
+size_t const num_storage_types 
+  = sizeof(storage_types) / sizeof(*storage_types);
+
+bool same_failinfo( prover::failinfo const& a, prover::failinfo const& b )
+{
+  if ( a.size() != b.size() ) return false;
+  for ( prover::failinfo::const_iterator i=a.begin(), j=b.begin(), e=a.end(); 
+        i != e; ++i, ++j )
+    if ( i->_row != j->_row || i->_lines != j->_lines ) 
+      return false;
+  return true;
+}
+
+void test_prover_plain_course(void)
+{
+  method m( "&-1-1-1,2", 6 );  // Plain Bob Minor
+
+  for ( size_t t = 0; t < num_storage_types; ++t ) {
+    prover::failinfo fi;
+    prover p( fi, 1, storage_types[t] );
+
+    row r(6);
+    bool ok = true;
+    for ( int l = 0; l < 5; ++l )
+      for ( method::const_iterator i=m.begin(), e=m.end(); i!=e; ++i ) 
+        ok = p.add_row( r *= *i ) && ok;
+
+    RINGING_TEST( ok && p.truth() );
+    RINGING_TEST( p.size() == 60 );
+    RINGING_TEST( p.duplicates() == 0 );
+    RINGING_TEST( fi.empty() );
+
+    // Another lead head
+    RINGING_TEST( !p.add_row( m.lh() ) );
+    RINGING_TEST( !p.truth() );
+    RINGING_TEST( p.count_row( m.lh() ) == 2 );
+    RINGING_TEST( p.duplicates() == 1 );
+    RINGING_TEST( fi.size() == 1 );
+    RINGING_TEST( fi.front()._row == m.lh() );
+    RINGING_TEST( fi.front()._lines.size() == 2 );
+    RINGING_TEST( fi.front()._lines.front() == 12 );
+    RINGING_TEST( fi.front()._lines.back() == 61 );
+
+    p.remove_row( m.lh() );
+    RINGING_TEST( p.truth() );
+    RINGING_TEST( p.size() == 60 );
+    RINGING_TEST( p.count_row( m.lh() ) == 1 );
+
+    RINGING_TEST_THROWS( p.remove_row( row("214365") ), logic_error );
+  }
+}
+
+void test_prover_max_occurs(void)
+{
+  for ( size_t t = 0; t < num_storage_types; ++t ) {
+    prover::failinfo fi;
+    prover p( fi, 2, storage_types[t] );
+
+    RINGING_TEST( p.add_row( row("2143") ) );
+    RINGING_TEST( p.add_row( row("1234") ) );
+    RINGING_TEST( p.add_row( row("2143") ) );
+    RINGING_TEST( p.truth() );
+    RINGING_TEST( p.duplicates() == 1 );
+    RINGING_TEST( !p.add_row( row("2143") ) );
+    RINGING_TEST( !p.add_row( row("2143") ) );
+
+    RINGING_TEST( fi.size() == 1 );
+    list<int> lines;
+    lines.push_back(1); lines.push_back(3); 
+    lines.push_back(4); lines.push_back(5);
+    RINGING_TEST( fi.front()._lines == lines );
+  }
+}
+
+void test_prover_branch(void)
+{
+  for ( size_t t = 0; t < num_storage_types; ++t ) {
+    prover::failinfo fi;
+    shared_pointer<prover> p( new prover( fi, 1, storage_types[t] ) );
+    p->add_row( row("1234") );
+    p->add_row( row("2143") );
+
+    shared_pointer<prover> b( prover::create_branch(p) );
+    RINGING_TEST( b->count_row( row("2143") ) == 1 );
+    RINGING_TEST( b->add_row( row("1324") ) );
+    RINGING_TEST( p->count_row( row("1324") ) == 0 );
+    RINGING_TEST( b->count_row( row("1324") ) == 1 );
+
+    RINGING_TEST( !b->add_row( row("1234") ) );
+    RINGING_TEST( !b->truth() );
+    RINGING_TEST( fi.size() == 1 && fi.front()._lines.back() == 4 );
+    RINGING_TEST_THROWS( b->remove_row( row("2143") ), logic_error );
+  }
+}
+
+void test_prover_storage_types_agree(void)
+{
+  // Add and remove a pseudo-random sequence of rows on four bells,
+  // which will be repeated many times, and check that each type of 
+  // storage gives identical results.
+  vector<row> rows;
+  {
+    row r(4);
+    do rows.push_back(r);
+    while ( !(r *= row("2341") * row("2134")).isrounds() );
+  }
+
+  prover::failinfo fi[ num_storage_types ];
+  scoped_pointer<prover> p[ num_storage_types ];
+  for ( size_t t = 0; t < num_storage_types; ++t )
+    p[t].reset( new prover( fi[t], 3, storage_types[t] ) );
+
+  vector<row> added;
+  unsigned long seed = 1;
+  bool ok = true;
+  for ( int n = 0; n < 2000; ++n ) {
+    seed = seed * 1103515245ul + 12345ul;
+    bool remove = (seed >> 16) % 3 == 0 && !added.empty();
+    row const r( remove ? added.back() : rows[ (seed >> 20) % rows.size() ] );
+    if (remove) added.pop_back(); else added.push_back(r);
+
+    bool rv[ num_storage_types ];
+    for ( size_t t = 0; t < num_storage_types; ++t )
+      if (remove) p[t]->remove_row(r);
+      else rv[t] = p[t]->add_row(r);
+
+    for ( size_t t = 1; t < num_storage_types; ++t )
+      if ( ( !remove && rv[t] != rv[0] ) 
+           || p[t]->truth() != p[0]->truth()
+           || p[t]->size() != p[0]->size()
+           || p[t]->duplicates() != p[0]->duplicates()
+           || p[t]->count_row(r) != p[0]->count_row(r)
+           || !same_failinfo( fi[t], fi[0] ) )
+        ok = false;
+  }
+  RINGING_TEST( ok );
+  RINGING_TEST( !fi[0].empty() );
+}
+
+void test_prover_extent_mixed_stages(void)
+{
+  // Rows on a different number of bells to the first should still be
+  // proved correctly.
+  prover::failinfo fi;
+  prover p( fi, 1, prover::extent_storage );
+  RINGING_TEST( p.add_row( row("2143") ) );
+  RINGING_TEST( p.add_row( row("21435") ) );
+  RINGING_TEST( p.add_row( row("1234") ) );
+  RINGING_TEST( p.size() == 3 );
+  RINGING_TEST( p.count_row( row("21435") ) == 1 );
+  RINGING_TEST( p.count_row( row("21345") ) == 0 );
+  RINGING_TEST( !p.add_row( row("21435") ) );
+  RINGING_TEST( fi.size() == 1 && fi.front()._lines.size() == 2 );
+  p.remove_row( row("21435") );
+  RINGING_TEST( p.truth() && p.size() == 3 );
+  RINGING_TEST_THROWS( p.remove_row( row("21345") ), logic_error );
+}
+
+RINGING_END_ANON_NAMESPACE
+  
+RINGING_START_TEST_FILE( proof )
+
+  RINGING_REGISTER_TEST( test_prover_plain_course )
+  RINGING_REGISTER_TEST( test_prover_max_occurs )
+  RINGING_REGISTER_TEST( test_prover_branch )
+  RINGING_REGISTER_TEST( test_prover_storage_types_agree )
+  RINGING_REGISTER_TEST( test_prover_extent_mixed_stages )
+
+RINGING_END_TEST_FILE
+
+RINGING_END_NAMESPACE
@@ -86,6 +86,30 @@ void test_row_copy(void)
   RINGING_TEST( b == c );
 }
 
+void test_row_copy_long(void)
+{
+  // Rows this long don't fit in the row's internal buffer.
+  row a( "1234567890ETABCDFGHJKLMNPQRSUVWYZ" ), c(a), s( "2143" );
+  RINGING_TEST( a == c );
+  RINGING_TEST( a.bells() == 33 );
+
+  s.swap(a);
+  RINGING_TEST( s == c );
+  RINGING_TEST( a == row( "2143" ) );
+
+  a = s;
+  RINGING_TEST( a == c );
+  s = row( "2143" );
+  RINGING_TEST( s.bells() == 4 );
+  RINGING_TEST( a * s == row( "2143567890ETABCDFGHJKLMNPQRSUVWYZ" ) );
+  RINGING_TEST( s * a == row( "2143567890ETABCDFGHJKLMNPQRSUVWYZ" ) );
+
+  a.resize(4);
+  RINGING_TEST( a == row( "1234" ) );
+  a.resize(30);
+  RINGING_TEST( a == row( 30 ) );
+}
+
 void test_row_invalid(void)
 {
   RINGING_TEST_THROWS( row( "124"       ), row::invalid  );
@@ -126,6 +150,69 @@ void test_row_multiply_row(void)
   RINGING_TEST( ( r *= "14253" ) == "31425" );
 }
 
+// The straightforward implementation of row multiplication, for
+// checking the optimised versions in row.cpp against.
+row reference_multiply( row const& x, row const& y )
+{
+  int const m = max( x.bells(), y.bells() );
+  vector<bell> p(m);
+  for ( int i = 0; i < m; ++i )
+    if ( i >= y.bells() ) p[i] = x[i];
+    else if ( y[i] >= x.bells() ) p[i] = y[i];
+    else p[i] = x[ y[i] ];
+  return row(p);
+}
+
+row shuffled_row( int n, unsigned long& seed )
+{
+  vector<bell> v;
+  for ( int i = 0; i < n; ++i ) v.push_back(i);
+  for ( int i = n-1; i > 0; --i ) {
+    seed = seed * 1103515245ul + 12345ul;
+    swap( v[i], v[ (seed >> 16) % (i+1) ] );
+  }
+  return row(v);
+}
+
+void test_row_multiply_exhaustive(void)
+{
+  // Every pair of rows on five bells, and on mixed numbers of bells
+  vector<row> rows;
+  {
+    vector<bell> v;
+    for ( int i = 0; i < 5; ++i ) v.push_back(i);
+    do rows.push_back( row(v) ); 
+    while ( next_permutation( v.begin(), v.end() ) );
+  }
+  rows.push_back( row( "2143" ) );
+  rows.push_back( row( "7654321" ) );
+
+  bool ok = true;
+  for ( vector<row>::const_iterator i=rows.begin(), e=rows.end(); i!=e; ++i )
+    for ( vector<row>::const_iterator j=rows.begin(); j!=e; ++j ) {
+      row const p( *i * *j );
+      if ( p != reference_multiply( *i, *j ) ) ok = false;
+      if ( p / *j != *i && i->bells() == j->bells() ) ok = false;
+    }
+  RINGING_TEST( ok );
+
+  // Random rows on every stage either side of the 16 bells that 
+  // can be transposed with a single vector instruction
+  unsigned long seed = 1;
+  for ( int n = 1; n <= 33; ++n ) {
+    bool ok = true;
+    for ( int k = 0; k < 200; ++k ) {
+      row const x( shuffled_row( n, seed ) ), y( shuffled_row( n, seed ) );
+      row const p( x * y );
+      if ( p != reference_multiply( x, y ) || p.bells() != n ) ok = false;
+      if ( p / y != x || x.inverse() * x != row(n) ) ok = false;
+      row q(x); q *= y;
+      if ( q != p ) ok = false;
+    }
+    RINGING_TEST( ok );
+  }
+}
+
 void test_row_divide_row(void)
 {
   RINGING_TEST( row( "642153" ) / 
@@ -540,10 +627,12 @@ RINGING_START_TEST_FILE( row )
 
   // Tests for the row class
   RINGING_REGISTER_TEST( test_row_copy )
+  RINGING_REGISTER_TEST( test_row_copy_long )
   RINGING_REGISTER_TEST( test_row_equals )
   RINGING_REGISTER_TEST( test_row_invalid )
   RINGING_REGISTER_TEST( test_row_subscript )
   RINGING_REGISTER_TEST( test_row_multiply_row )
+  RINGING_REGISTER_TEST( test_row_multiply_exhaustive )
   RINGING_REGISTER_TEST( test_row_divide_row )
   RINGING_REGISTER_TEST( test_row_multiply_change )
   RINGING_REGISTER_TEST( test_row_inverse )
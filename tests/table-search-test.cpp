@@ -0,0 +1,113 @@
+// -*- C++ -*- table-search-test.cpp - Tests for the table_search class
+// Copyright (C) 2026 The Ringing Class Library contributors
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// $Id$
+
+#include <ringing/table_search.h>
+#include <ringing/touch.h>
+#include <ringing/method.h>
+#include "test-base.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+RINGING_START_NAMESPACE
+
+RINGING_USING_STD
+
+RINGING_START_ANON_NAMESPACE
+
+// Record each touch as a string of its changes
+class touch_recorder : public search_base::outputer
+{
+public:
+  touch_recorder( size_t limit = size_t(-1) ) : limit(limit) {}
+
+  virtual bool operator()( const touch &t )
+  {
+    string s;
+    for ( touch::const_iterator i = t.begin(), e = t.end(); i != e; ++i )
+      s += i->print() + '.';
+    touches.push_back(s);
+    return touches.size() >= limit;
+  }
+
+  size_t limit;
+  vector<string> touches;
+};
+
+vector<string> run_search( search_base const& s, unsigned threads,
+                           size_t limit = size_t(-1) )
+{
+  touch_recorder o( limit );
+  s.run( o, threads );
+  sort( o.touches.begin(), o.touches.end() );
+  return o.touches;
+}
+
+void test_table_search_threads(void)
+{
+  // Bobs and singles of Plain Bob Minor, up to 144 changes
+  vector<change> calls;
+  calls.push_back( change( 6, "14" ) );
+  calls.push_back( change( 6, "1234" ) );
+  method m( "&-1-1-1,2", 6 );
+
+  table_search s( m, calls, group(), make_pair( size_t(0), size_t(144) ),
+                  table_search::length_in_changes );
+
+  vector<string> const serial( run_search( s, 1 ) );
+  RINGING_TEST( serial.size() == 1598 );
+  RINGING_TEST( run_search( s, 2 ) == serial );
+  RINGING_TEST( run_search( s, 7 ) == serial );
+
+  s.set_split_depth( 1 );
+  RINGING_TEST( run_search( s, 4 ) == serial );
+  s.set_split_depth( 30 );
+  RINGING_TEST( run_search( s, 4 ) == serial );
+
+  // Halting the search in one thread should stop the others
+  RINGING_TEST( run_search( s, 4, 100 ).size() == 100 );
+}
+
+void test_table_search_threads_multipart(void)
+{
+  // Bobs and singles of Plain Bob Minor in three parts
+  vector<change> calls;
+  calls.push_back( change( 6, "14" ) );
+  calls.push_back( change( 6, "1234" ) );
+  method m( "&-1-1-1,2", 6 );
+
+  table_search s( m, calls, group( row("134256") ),
+                  make_pair( size_t(0), size_t(360) ),
+                  table_search::length_in_changes );
+
+  vector<string> const serial( run_search( s, 1 ) );
+  RINGING_TEST( !serial.empty() );
+  RINGING_TEST( run_search( s, 3 ) == serial );
+}
+
+RINGING_END_ANON_NAMESPACE
+
+RINGING_START_TEST_FILE( table_search )
+
+  RINGING_REGISTER_TEST( test_table_search_threads )
+  RINGING_REGISTER_TEST( test_table_search_threads_multipart )
+
+RINGING_END_TEST_FILE
+
+RINGING_END_NAMESPACE
@@ -31,6 +31,11 @@ int test_main()
   RINGING_RUN_TEST_FILE( method )
   RINGING_RUN_TEST_FILE( music )
   RINGING_RUN_TEST_FILE( extent )
+  RINGING_RUN_TEST_FILE( proof )
+  RINGING_RUN_TEST_FILE( table_search )
+  RINGING_RUN_TEST_FILE( multtab )
+  RINGING_RUN_TEST_FILE( group )
+  RINGING_RUN_TEST_FILE( falseness )
 
   RINGING_USING_TEST
   if ( run_tests( true ) ) 